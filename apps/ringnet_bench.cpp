@@ -0,0 +1,90 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include <iostream>
+#include <chrono>
+#include "ringnet/net.h"
+
+// Echo round trips over loopback, counting heap allocations made anywhere in the process while they run.
+// Also how long a client that refuses every option waits between connecting and the game's first output.
+// usage: ringnet_bench [round trips]
+// RINGNET_CPUS=2,3 pins the two network threads and RINGNET_GAME_CPU=0 puts the client on a core of its own.
+// Run it with and without to compare pinned and unpinned throughput.
+
+static std::atomic<uint64_t> allocations{0};
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if(auto p = malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+
+boost::asio::awaitable<void> echo(std::shared_ptr<ring::net::MudConnection> con) {
+    con->sendText("welcome\n", ring::net::Text);
+    while(auto g = co_await con->readLine()) con->sendText(g->command, ring::net::Text);
+}
+
+int main(int argc, char **argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    auto &manager = ring::net::manager;
+    manager.resolve_hostnames = false;
+    manager.throttle_limits = {1e9, 1e9, 1e12, 1e12};
+    if(getenv("RINGNET_URING")) manager.enableIoUring();
+    if(auto cpus = getenv("RINGNET_CPUS")) manager.affinity.cpus = ring::net::parseCpuList(cpus);
+    if(auto game = getenv("RINGNET_GAME_CPU")) manager.affinity.game_cpu = atoi(game);
+    bool pinned = manager.pinGame() || !manager.affinity.cpus.empty();
+    if(!manager.listenPlainTelnet("127.0.0.1", 2010)) return 1;
+    std::thread net([&] { manager.run(2); });
+
+    boost::asio::io_context client_context;
+    boost::asio::ip::tcp::socket client(client_context);
+    auto connect_start = std::chrono::steady_clock::now();
+    client.connect({boost::asio::ip::make_address("127.0.0.1"), 2010});
+
+    // the handshake is all WILLs and DOs. say no to every one of them.
+    std::array<uint8_t, 4096> shake;
+    auto got = client.read_some(boost::asio::buffer(shake));
+    std::vector<uint8_t> refusals;
+    for(std::size_t i = 0; i + 2 < got; i += 3) {
+        refusals.insert(refusals.end(), {255, uint8_t(shake[i + 1] == 251 ? 254 : 252), shake[i + 2]});
+    }
+    boost::asio::write(client, boost::asio::buffer(refusals));
+
+    // wait for the handshake to settle and the game to hear about us.
+    ring::net::ConnectionMsg m;
+    while(!manager.events.pop(m) || m.event != ring::net::CONNECTED) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    {
+        std::lock_guard<std::mutex> guard(manager.conn_mutex);
+        boost::asio::co_spawn(manager.executor, echo(manager.connections[m.conn_id]), boost::asio::detached);
+    }
+    std::array<char, 4096> buf;
+    std::string greeting;
+    while(greeting.find("welcome") == std::string::npos) greeting.append(buf.data(), client.read_some(boost::asio::buffer(buf)));
+    auto first_output = std::chrono::steady_clock::now() - connect_start;
+    std::cout << "connect to first output: " << std::chrono::duration_cast<std::chrono::microseconds>(first_output).count() / 1000.0 << " ms" << std::endl;
+
+    auto roundTrip = [&] {
+        boost::asio::write(client, boost::asio::buffer("ping\r\n", 6));
+        std::size_t got = 0;
+        while(got < 4) got += client.read_some(boost::asio::buffer(buf));
+    };
+    for(int i = 0; i < 1000; i++) roundTrip();
+
+    auto before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++) roundTrip();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto made = allocations.load() - before;
+
+    if(pinned) std::cout << "placement: " << manager.placement.serialize().dump() << std::endl;
+    std::cout << (pinned ? "pinned: " : "unpinned: ") << rounds << " round trips in " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms, "
+              << double(made) / rounds << " allocations per round trip" << std::endl;
+
+    manager.executor.stop();
+    net.join();
+    _exit(0);
+}
@@ -0,0 +1,70 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include <iostream>
+#include <unordered_map>
+#include "ringnet/portal.h"
+#include "ringnet/color.h"
+
+// The game half of a split deployment. Attaches to a running ringnet_portal and echoes input back.
+// "shutdown" exits the game alone; start it again and every connection is still there.
+
+int main(int argc, char **argv) {
+    std::string segment = argc > 1 ? argv[1] : "/ringnet_portal";
+    ring::net::portal_client portal;
+
+    while(!portal.attach(segment)) {
+        std::cout << "Waiting for portal on " << segment << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    std::cout << "Attached to portal " << segment << std::endl;
+
+    std::unordered_map<std::string, ring::net::client_details> players;
+    ring::net::portal_message msg;
+    while(true) {
+        if(!portal.poll(msg)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        switch(msg.type) {
+            case ring::net::PortalResyncBegin:
+                players.clear();
+                break;
+            case ring::net::PortalResyncEnd:
+                std::cout << "Resynced with " << players.size() << " connections" << std::endl;
+                for(auto &p : players) portal.send(p.first, "The game is back.");
+                break;
+            case ring::net::PortalDetails:
+            {
+                auto j = nlohmann::json::parse(msg.body, nullptr, false);
+                if(!j.is_discarded()) players[msg.conn_id].load(j);
+                break;
+            }
+            case ring::net::PortalEvent:
+                std::cout << "Got an Event: " << msg.conn_id << " - " << int(msg.extra) << std::endl;
+                if(msg.extra == ring::net::DISCONNECTED || msg.extra == ring::net::TIMEOUT) {
+                    players.erase(msg.conn_id);
+                    portal.close(msg.conn_id);
+                }
+                break;
+            case ring::net::PortalInput: {
+                std::cout << "Message from " << msg.conn_id << std::endl;
+                ring::color::Markup m("|gEchoing:|n " + ring::color::escape(msg.body));
+                auto found = players.find(msg.conn_id);
+                auto tier = found != players.end() ? found->second.renderColor() : ring::net::NoColor;
+                portal.send(msg.conn_id, m.render(tier));
+                if(msg.body == "shutdown") return 0;
+                break;
+            }
+            case ring::net::PortalGMCP: {
+                std::string_view package, data;
+                ring::net::splitGMCP(msg.body, package, data);
+                std::cout << "GMCP from " << msg.conn_id << ": " << package << " " << data << std::endl;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include <iostream>
+#include "ringnet/net.h"
+
+// The network half of a split deployment: holds every socket and hands the game what it needs over
+// shared memory. Run ringnet_game next to it; the game can be restarted without anyone disconnecting.
+
+int main(int argc, char **argv) {
+    std::string segment = argc > 1 ? argv[1] : "/ringnet_portal";
+
+    ring::net::manager.throttle_limits = {5.0, 20.0, 4096.0, 16384.0};
+    ring::net::manager.admission_limits = {10, 2.0, 10.0};
+    ring::net::manager.timeouts.idle = std::chrono::minutes(30);
+    ring::net::manager.timeouts.keepalive = std::chrono::seconds(60);
+    ring::net::manager.gmcp.subscribe("Core");
+    ring::net::manager.gmcp.subscribe("Char");
+    if(getenv("RINGNET_URING")) ring::net::manager.enableIoUring();
+
+    if(!ring::net::manager.enablePortal(segment)) {
+        std::cout << "Error! Cannot create portal segment " << segment << std::endl;
+        exit(1);
+    }
+    if(!ring::net::manager.listenPlainTelnet("0.0.0.0", 2008)) {
+        std::cout << "Error! Cannot bind to socket!" << std::endl;
+        exit(1);
+    }
+    std::cout << "Portal up on " << segment << std::endl;
+    ring::net::manager.run();
+}
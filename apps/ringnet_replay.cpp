@@ -0,0 +1,130 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include "ringnet/net.h"
+#include "ringnet/color.h"
+
+// Feeds a capture made with RINGNET_CAPTURE back through the telnet layer, with the same echo game as
+// ringnet_test answering, and reports how much output that made next to what was recorded.
+// usage: ringnet_replay <trace> [realtime]
+// without realtime the records go through as fast as they can, for profiling the parser and output path.
+
+// a connection with no socket: whatever it would write is only counted.
+class ReplayConnection : public ring::telnet::MudTelnetConnection {
+public:
+    ReplayConnection(std::string &conn_id, boost::asio::io_context &con) : MudTelnetConnection(conn_id, con) {}
+    void sendBytes(std::vector<uint8_t> data, ring::telnet::OutputLane = ring::telnet::LaneBulk) override {
+        touchOutput();
+        // nothing to wait on: it's out as soon as it's made.
+        noteOutput();
+        noteFlushed();
+        produced += data.size();
+    }
+    void onClose() override {}
+    std::size_t memoryFootprint() override { return sizeof(*this) + heapBytes(); }
+    uint64_t produced = 0;
+protected:
+    void disconnect() override {}
+};
+
+struct trace_entry {
+    ring::net::capture_record rec;
+    const uint8_t *data;
+};
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <trace> [realtime]" << std::endl;
+        return 1;
+    }
+    bool realtime = argc > 2 && std::string(argv[2]) == "realtime";
+
+    std::ifstream in(argv[1], std::ios::binary);
+    std::vector<uint8_t> raw((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    ring::net::capture_file_header header;
+    if(raw.size() < sizeof(header)) {
+        std::cerr << "Not a capture: " << argv[1] << std::endl;
+        return 1;
+    }
+    memcpy(&header, raw.data(), sizeof(header));
+    if(memcmp(header.magic, "RNCAP", 5) || header.version != ring::net::capture_version) {
+        std::cerr << "Not a capture, or from another version: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    std::vector<trace_entry> trace;
+    for(std::size_t pos = sizeof(header); pos + sizeof(ring::net::capture_record) <= raw.size();) {
+        trace_entry e;
+        memcpy(&e.rec, raw.data() + pos, sizeof(e.rec));
+        pos += sizeof(e.rec);
+        if(pos + e.rec.length() > raw.size()) {
+            std::cerr << "Trace is cut short, stopping at the last whole record." << std::endl;
+            break;
+        }
+        e.data = raw.data() + pos;
+        pos += e.rec.length();
+        trace.push_back(e);
+    }
+    // each network thread's records arrive in batches. put them back in the order they happened.
+    std::stable_sort(trace.begin(), trace.end(), [](auto &a, auto &b) { return a.rec.when < b.rec.when; });
+
+    auto &manager = ring::net::manager;
+    manager.resolve_hostnames = false;
+    manager.throttle_limits = {1e9, 1e9, 1e12, 1e12};
+
+    std::unordered_map<uint32_t, std::shared_ptr<ReplayConnection>> conns;
+    uint64_t bytes_in = 0, recorded_out = 0, lines = 0;
+    auto answer = [&](ReplayConnection &con) {
+        ring::net::GameMsg g;
+        while(con.takeInput(g)) {
+            lines++;
+            con.sendMarkup(ring::color::Markup("|gEchoing:|n " + ring::color::escape(g.command)));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for(auto &e : trace) {
+        if(realtime) std::this_thread::sleep_until(start + std::chrono::nanoseconds(e.rec.when));
+        switch(e.rec.kind()) {
+            case ring::net::CaptureOpen: {
+                std::string conn_id(reinterpret_cast<const char*>(e.data), e.rec.length());
+                auto con = std::make_shared<ReplayConnection>(conn_id, manager.executor);
+                conns[e.rec.conn] = con;
+                con->start();
+                break;
+            }
+            case ring::net::CaptureIn: {
+                auto found = conns.find(e.rec.conn);
+                if(found == conns.end()) break;
+                bytes_in += e.rec.length();
+                found->second->feed(e.data, e.rec.length());
+                answer(*found->second);
+                break;
+            }
+            case ring::net::CaptureOut:
+                recorded_out += e.rec.length();
+                break;
+        }
+        // wakeups and anything else the connections posted.
+        manager.executor.poll();
+        ring::net::ConnectionMsg m;
+        while(manager.events.pop(m)) {}
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t produced = 0;
+    for(auto &c : conns) produced += c.second->produced;
+    std::cout << "records: " << trace.size() << " connections: " << conns.size() << std::endl;
+    std::cout << "bytes in: " << bytes_in << " lines: " << lines << std::endl;
+    std::cout << "bytes out: " << produced << " produced, " << recorded_out << " recorded" << std::endl;
+    std::cout << "elapsed: " << elapsed << "s";
+    if(elapsed > 0) std::cout << " (" << bytes_in / elapsed / 1e6 << " MB/s in)";
+    std::cout << std::endl;
+    std::cout << "latency: " << ring::net::latency.serialize().dump() << std::endl;
+    manager.running = false;
+    return 0;
+}
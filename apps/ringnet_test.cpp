@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <fstream>
 #include "ringnet/net.h"
+#include "ringnet/color.h"
 
 bool copyover = false;
 
@@ -19,8 +20,6 @@ void copyover_recover() {
     }
 }
 
-std::unordered_map<std::string, std::weak_ptr<ring::net::MudConnection>> conns;
-
 void test_copyover() {
     std::ofstream c(cpath);
     c << ring::net::manager.copyover().dump(4) << std::endl;
@@ -29,42 +28,85 @@ void test_copyover() {
     copyover = true;
 }
 
-void check_status(boost::system::error_code ec, boost::asio::steady_timer &timer) {
-    if(ec) std::cout << "Got an error: " << ec << std::endl;
+ring::net::tick_scheduler scheduler(ring::net::manager);
 
-    ring::net::ConnectionMsg m;
-    if(ring::net::manager.events.pop(m)) {
+void game_tick(ring::net::game_tick &t) {
+    for(auto &m : t.events) {
         std::cout << "Got an Event: " << m.conn_id << " - " << m.event << std::endl;
 
         if (m.event == ring::net::CONNECTED) {
             ring::net::manager.conn_mutex.lock();
             auto find = ring::net::manager.connections.find(m.conn_id);
-            if (find != ring::net::manager.connections.end()) conns.emplace(m.conn_id, find->second);
+            if (find != ring::net::manager.connections.end()) {
+                std::cout << "Connected from " << find->second->details.hostIp << " (" << find->second->details.hostName << ")" << std::endl;
+                auto &d = find->second->details;
+                if(d.peer_pid) std::cout << "Peer pid " << d.peer_pid << ", uid " << d.peer_uid << ", gid " << d.peer_gid << std::endl;
+            }
             ring::net::manager.conn_mutex.unlock();
         }
-        if (m.event == ring::net::DISCONNECTED) {
-            conns.erase(m.conn_id);
-        }
-        if (m.event == ring::net::TIMEOUT) {
-            conns.erase(m.conn_id);
+        if (m.event == ring::net::DISCONNECTED || m.event == ring::net::TIMEOUT) {
+            ring::net::manager.closeConn(m.conn_id);
         }
     }
-        ring::net::GameMsg g;
-        for(auto &c : conns) {
-            if(auto con = c.second.lock()) {
-                if(con->game_messages.pop(g)) {
-                    std::cout << "Message from " << con->conn_id << std::endl;
-                    con->sendLine("Echoing: " + g.command);
-                    if(g.command == "copyover") test_copyover();
-                };
-            }
+    for(auto &[con, g] : t.input) {
+        if(!g.gmcp.empty()) {
+            std::cout << "GMCP from " << con->conn_id << ": " << g.gmcp << " " << g.gmcpData().dump() << std::endl;
+            continue;
+        }
+        std::cout << "Message from " << con->conn_id << std::endl;
+        con->sendMarkup(ring::color::Markup("|gEchoing:|n " + ring::color::escape(g.command)));
+        if(g.command == "copyover") test_copyover();
+        if(g.command == "latency") con->sendLine(ring::net::latency.serialize().dump());
+        if(g.command == "lag") con->sendLine(ring::net::lag.serialize().dump());
+        // motd.txt is read once and re-read only when it changes. edit it and ask again.
+        if(g.command == "motd") con->sendAsset(ring::net::manager.assets.get("motd.txt"));
+        if(g.command == "assets") con->sendLine(ring::net::manager.assets.serialize().dump());
+        if(g.command == "output") con->sendLine(ring::net::manager.output.serialize().dump());
+        if(g.command == "spam") {
+            // many small sends in one tick. they're all held until it ends, and all have to arrive.
+            for(int i = 0; i < 300; i++) con->sendLine("Spam line " + std::to_string(i));
+        }
+        if(g.command == "look") {
+            // the room has to arrive before the prompt that follows it.
+            con->sendLine("You are standing in a small room.");
+            con->sendPrompt("HP:100> ");
+        }
+        if(g.command == "flood") {
+            // a wall of text with a prompt and a GMCP update behind it. they go out after the first write
+            // quantum of it rather than after all of it.
+            std::string wall;
+            for(int i = 0; i < 4000; i++) wall += "Line " + std::to_string(i) + " of a very long help file.\n";
+            con->sendText(wall, ring::net::Text);
+            con->sendGMCP("Char.Vitals", {{"hp", 100}});
+            con->sendPrompt("> ");
         }
-    timer.async_wait([&](auto ec) {check_status(ec, timer); });
+    }
 }
 
 int main(int argc, char **argv) {
 
     bool copyover_recovered = false;
+    ring::net::manager.throttle_limits = {5.0, 20.0, 4096.0, 16384.0};
+    ring::net::manager.admission_limits = {10, 2.0, 10.0};
+    ring::net::manager.timeouts.idle = std::chrono::minutes(30);
+    ring::net::manager.timeouts.keepalive = std::chrono::seconds(60);
+    ring::net::manager.gmcp.subscribe("Core");
+    ring::net::manager.gmcp.subscribe("Char");
+    // an environment variable rather than an argument, so it survives the copyover exec.
+    if(getenv("RINGNET_URING")) ring::net::manager.enableIoUring();
+    // RINGNET_CAPTURE=trace.bin records the socket traffic for ringnet_replay. each process after a
+    // copyover gets the next free trace.bin.1, trace.bin.2 and so on: a capture's clock and connection
+    // numbers start over with it, so it can't carry on in the old file.
+    if(auto trace = getenv("RINGNET_CAPTURE")) {
+        std::string path = trace;
+        for(int gen = 1; std::filesystem::exists(cpath) && std::filesystem::exists(path); gen++) {
+            path = std::string(trace) + "." + std::to_string(gen);
+        }
+        ring::net::manager.capture.open(path);
+    }
+    // RINGNET_CPUS=2-7 pins the network threads, RINGNET_GAME_CPU=1 keeps them off the game's core.
+    if(auto cpus = getenv("RINGNET_CPUS")) ring::net::manager.affinity.cpus = ring::net::parseCpuList(cpus);
+    if(auto game = getenv("RINGNET_GAME_CPU")) ring::net::manager.affinity.game_cpu = atoi(game);
 
     if(std::filesystem::exists(cpath)) {
         std::ifstream jf(cpath.string());
@@ -78,15 +120,22 @@ int main(int argc, char **argv) {
             std::cout << "Error! Cannot bind to socket!" << std::endl;
             exit(1);
         }
+        // the same thing again for connections coming in through a load balancer.
+        if(!ring::net::manager.listenPlainTelnet("0.0.0.0", 2009, true)) {
+            std::cout << "Error! Cannot bind to socket!" << std::endl;
+            exit(1);
+        }
+        // RINGNET_UNIX=/run/ringnet.sock for a gateway on this host.
+        if(auto path = getenv("RINGNET_UNIX")) {
+            if(!ring::net::manager.listenUnixTelnet(path)) exit(1);
+        }
     }
     if(copyover_recovered) {
         std::cout << "Recovered from copyover!" << std::endl;
         remove(cpath.string().c_str());
         copyover_recover();
     }
-    boost::asio::steady_timer start_timer(ring::net::manager.executor, boost::asio::chrono::milliseconds(300));
-    start_timer.async_wait([&](auto ec) {check_status(ec, start_timer); });
-    ring::net::manager.run();
+    scheduler.run({std::chrono::milliseconds(100)}, game_tick, std::thread::hardware_concurrency());
 
     if(copyover) {
         std::cout << "Attempting copyover!" << std::endl;
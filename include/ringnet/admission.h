@@ -0,0 +1,57 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_ADMISSION_H
+#define RINGNET_ADMISSION_H
+
+#include "throttle.h"
+#include "boost/asio.hpp"
+#include <array>
+
+namespace ring::net {
+
+    // An address as a map key. IPv4 is kept in its v6-mapped form so both stacks land on one entry.
+    using address_key = std::array<unsigned char, 16>;
+    address_key addressKey(const boost::asio::ip::address &addr);
+
+    struct address_key_hash {
+        std::size_t operator()(const address_key &k) const;
+    };
+
+    // Per remote address limits, checked before a connection object exists. Zero disables a limit.
+    // connect_rate is new connections per second with connect_burst of slack.
+    struct admission_config {
+        unsigned max_per_ip = 0;
+        double connect_rate = 0.0, connect_burst = 0.0;
+    };
+
+    struct admission_stats {
+        std::atomic<uint64_t> admitted{0}, rejected_cap{0}, rejected_rate{0};
+        nlohmann::json serialize() const;
+    };
+
+    // Tracks how many connections each address holds and how fast it's been opening them.
+    class admission_control {
+    public:
+        // Counts the connection if it's allowed in.
+        bool admit(const boost::asio::ip::address &addr, const admission_config &cfg);
+        // Counts a connection that's already in, like one carried across a copyover.
+        void track(const boost::asio::ip::address &addr);
+        void release(const boost::asio::ip::address &addr);
+        std::size_t tracked();
+        admission_stats stats;
+    protected:
+        struct ip_state {
+            unsigned open = 0;
+            token_bucket rate;
+        };
+        std::mutex admission_mutex;
+        std::unordered_map<address_key, ip_state, address_key_hash> addresses;
+        uint32_t admits_since_sweep = 0;
+        void sweep(throttle_clock::time_point now);
+    };
+
+}
+
+#endif //RINGNET_ADMISSION_H
@@ -0,0 +1,52 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_AFFINITY_H
+#define RINGNET_AFFINITY_H
+
+#include "sysdeps.h"
+#include "nlohmann/json.hpp"
+
+namespace ring::net {
+
+    // Where the executor threads run. With cpus empty and no game_cpu the scheduler decides, as before.
+    struct affinity_config {
+        // executor thread i is pinned to cpus[i % cpus.size()].
+        std::vector<int> cpus;
+        // kept free of executor threads. pinGame() puts the calling thread on it.
+        int game_cpu = -1;
+        // fill each executor thread's handler cache once it's pinned, so the memory comes from its own node.
+        bool numa_local = true;
+    };
+
+    // "0-3,8,10-11", as taskset and isolcpus take them. anything that doesn't parse is skipped.
+    std::vector<int> parseCpuList(const std::string &list);
+    // the CPUs this process may run on, as they were before any thread was pinned.
+    std::vector<int> allowedCpus();
+    // the NUMA node a CPU belongs to, or -1 if the kernel doesn't say.
+    int numaNodeOf(int cpu);
+    // restricts the calling thread to the given CPUs. false if none of them could be used.
+    bool pinThread(const std::vector<int> &cpus);
+
+    // Pins executor threads as they start, according to an affinity_config.
+    class thread_placement {
+    public:
+        void configure(const affinity_config &cfg);
+        // pins the calling thread as executor thread index and warms its memory. a no-op when unconfigured.
+        void enter(std::size_t index);
+        // the CPUs executor thread index may run on. empty if it's left alone.
+        std::vector<int> cpusFor(std::size_t index) const;
+        nlohmann::json serialize();
+    protected:
+        affinity_config config;
+        // everything allowed but the game's CPU, for when only isolation was asked for.
+        std::vector<int> shared;
+        std::mutex placed_mutex;
+        // what each thread actually got, for serialize().
+        std::map<std::size_t, std::pair<int, int>> placed;
+    };
+
+}
+
+#endif //RINGNET_AFFINITY_H
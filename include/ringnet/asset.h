@@ -0,0 +1,55 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_ASSET_H
+#define RINGNET_ASSET_H
+
+#include "connection.h"
+#include <array>
+#include <chrono>
+
+namespace ring::net {
+
+    // A text file in pipe markup, rendered and framed for telnet once per color tier. Never changed
+    // after it's built, so any number of connections can send from it at once without copying it.
+    struct static_asset {
+        std::string path;
+        fs::file_time_type mtime;
+        // the file as it was read, for connections that can't take the wire form as is.
+        std::string source;
+        // by ColorType: CRLF line ends, IAC doubled, ready for the socket.
+        std::array<std::shared_ptr<const std::vector<uint8_t>>, 4> wire;
+    };
+
+    struct asset_stats {
+        std::atomic<uint64_t> loads{0}, reloads{0}, hits{0}, failures{0};
+        nlohmann::json serialize() const;
+    };
+
+    // MOTDs, banners, help files and maps, loaded on first use and shared from then on. A file is
+    // checked for changes at most once per recheck interval, and rebuilt when its mtime moves.
+    class asset_cache {
+    public:
+        // null if the file can't be read.
+        std::shared_ptr<const static_asset> get(const std::string &path);
+        void forget(const std::string &path);
+        void clear();
+        // heap held by the cached assets, wire forms included.
+        std::size_t bytes();
+        nlohmann::json serialize();
+        std::chrono::milliseconds recheck{1000};
+        asset_stats stats;
+    protected:
+        struct entry {
+            std::shared_ptr<const static_asset> asset;
+            std::chrono::steady_clock::time_point checked;
+        };
+        std::mutex cache_mutex;
+        std::unordered_map<std::string, entry> assets;
+        std::shared_ptr<const static_asset> load(const std::string &path, fs::file_time_type mtime);
+    };
+
+}
+
+#endif //RINGNET_ASSET_H
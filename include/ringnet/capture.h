@@ -0,0 +1,92 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_CAPTURE_H
+#define RINGNET_CAPTURE_H
+
+#include "sysdeps.h"
+#include <chrono>
+#include <cstdio>
+#include "nlohmann/json.hpp"
+
+namespace ring::net {
+
+    // A trace file is a capture_file_header followed by records, each a capture_record and then
+    // its payload. Records from different network threads are written in batches, so they are only
+    // in order per thread. Sort by time before using them.
+    enum CaptureKind : uint8_t {
+        CaptureOpen = 0, // first sight of a connection. payload is its conn_id
+        CaptureIn = 1, // bytes read off the socket
+        CaptureOut = 2 // bytes written to the socket
+    };
+
+    struct capture_file_header {
+        char magic[8]; // "RNCAP\0\0\0"
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t started; // wall clock, nanoseconds since the epoch
+    };
+
+    struct capture_record {
+        uint64_t when; // nanoseconds since the capture started
+        uint32_t conn; // numbered from 1 in order of first sight
+        uint32_t length_kind; // payload length << 8 | CaptureKind
+        uint32_t length() const { return length_kind >> 8; }
+        CaptureKind kind() const { return static_cast<CaptureKind>(length_kind & 0xFF); }
+    };
+
+    constexpr uint32_t capture_version = 1;
+
+    struct capture_stats {
+        std::atomic<uint64_t> records{0}, bytes{0}, dropped{0};
+        nlohmann::json serialize() const;
+    };
+
+    // One network thread's share of a capture: a single producer, single consumer byte ring.
+    class capture_ring {
+    public:
+        explicit capture_ring(std::size_t capacity);
+        // false, and nothing written, if there isn't room.
+        bool write(const capture_record &rec, const uint8_t *data, std::size_t len);
+        // hands everything written so far to the file.
+        std::size_t drain(FILE *out);
+        void reset();
+    protected:
+        std::vector<uint8_t> ring;
+        std::size_t mask;
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        void put(uint64_t pos, const void *src, std::size_t len);
+    };
+
+    // Opt-in recording of raw socket traffic. Recording only ever touches the calling thread's ring;
+    // a background thread moves the rings to the file. If a ring fills up faster than that, records
+    // are dropped and counted rather than ever blocking the network. open() and close() are meant
+    // for one control thread.
+    class io_capture {
+    public:
+        ~io_capture();
+        bool open(const std::string &path, std::size_t ring_bytes = 1 << 20);
+        void close();
+        bool active() const;
+        // a fresh number for a connection, to use in its records.
+        uint32_t nextConnection();
+        void record(uint32_t conn, CaptureKind kind, const uint8_t *data, std::size_t len);
+        capture_stats stats;
+    protected:
+        std::atomic<bool> enabled{false};
+        std::atomic<uint32_t> connections{0};
+        std::size_t ring_bytes = 0;
+        std::chrono::steady_clock::time_point started;
+        FILE *file = nullptr;
+        std::mutex ring_mutex;
+        std::vector<std::unique_ptr<capture_ring>> rings;
+        std::thread flusher;
+        capture_ring *local();
+        void flush();
+    };
+
+}
+
+#endif //RINGNET_CAPTURE_H
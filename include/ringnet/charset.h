@@ -0,0 +1,26 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_CHARSET_H
+#define RINGNET_CHARSET_H
+
+#include "connection.h"
+#include <string_view>
+
+namespace ring::text {
+
+    // Length of the leading run of 7-bit bytes.
+    std::size_t asciiPrefix(const char *data, std::size_t length);
+
+    bool validUtf8(std::string_view s);
+    // Returns the text unchanged if it's valid, otherwise with each bad byte replaced by U+FFFD.
+    std::string sanitizeUtf8(std::string_view s);
+
+    // Legacy charset bytes to UTF-8, and back. Characters the target can't show become '?'.
+    std::string toUtf8(std::string_view s, net::CharsetType from);
+    std::string fromUtf8(std::string_view s, net::CharsetType to);
+
+}
+
+#endif //RINGNET_CHARSET_H
@@ -0,0 +1,83 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_COLOR_H
+#define RINGNET_COLOR_H
+
+#include "connection.h"
+#include <array>
+#include <string_view>
+
+namespace ring::color {
+
+    // Pipe markup, in the style most MUD codebases use:
+    //   |r |g |y |b |m |c |w |x     foreground, uppercase for bright. |n resets everything.
+    //   |[r                         background, and so on for the other forms below.
+    //   |500                        xterm 6x6x6 color cube, each digit 0-5.
+    //   |=a ... |=z                 grayscale ramp, black to white.
+    //   |#ff8800                    truecolor.
+    //   |h |u |i |*                 bold, underline, italic, inverse. |H |U |I turn them back off.
+    //   ||                          a literal pipe.
+    // Anything unrecognized is left in the text as-is.
+
+    enum ColorKind : uint8_t {
+        NoKind = 0,
+        Ansi16 = 1,
+        Xterm256 = 2,
+        Rgb = 3
+    };
+
+    enum Attributes : uint8_t {
+        Bold = 1,
+        Underline = 2,
+        Italic = 4,
+        Inverse = 8
+    };
+
+    // kind in the top byte, index or 0xRRGGBB in the rest.
+    using color_code = uint32_t;
+
+    struct style {
+        color_code fg = 0, bg = 0;
+        uint8_t attrs = 0;
+        bool operator==(const style &other) const;
+        bool operator!=(const style &other) const;
+        bool plain() const;
+    };
+
+    // The parsed form: the stripped text plus the offsets where the style changes.
+    struct span {
+        uint32_t start;
+        style st;
+    };
+
+    uint8_t rgbToXterm(uint8_t r, uint8_t g, uint8_t b);
+    uint8_t xtermToAnsi(uint8_t index);
+
+    class Markup {
+    public:
+        explicit Markup(std::string_view src);
+        Markup(const Markup&) = delete;
+        Markup& operator=(const Markup&) = delete;
+        // Rendered once per color tier, however many connections it gets sent to.
+        const std::string& render(net::ColorType tier) const;
+        const std::string& plain() const;
+    protected:
+        std::string text;
+        std::vector<span> spans;
+        mutable std::array<std::string, 4> rendered;
+        mutable std::array<std::once_flag, 4> rendered_once;
+        void setStyle(const style &st);
+        std::size_t parseCode(std::string_view src, std::size_t pos, style &st);
+        std::string renderTier(net::ColorType tier) const;
+    };
+
+    std::string render(std::string_view src, net::ColorType tier);
+    std::string strip(std::string_view src);
+    // doubles up pipes so player-supplied text can be embedded in markup safely.
+    std::string escape(std::string_view src);
+
+}
+
+#endif //RINGNET_COLOR_H
@@ -6,17 +6,30 @@
 #define RINGNET_CONNECTION_H
 
 #include "sysdeps.h"
+#include "throttle.h"
+#include "queue.h"
+#include "handler_alloc.h"
+#include "latency.h"
+#include "lag.h"
 
 #include "boost/asio.hpp"
+#include "boost/asio/awaitable.hpp"
 #include "boost/lockfree/spsc_queue.hpp"
 #include "nlohmann/json.hpp"
 
+namespace ring::color {
+    class Markup;
+}
+
 namespace ring::net {
 
+    struct static_asset;
+
     enum ClientType : uint8_t {
         TcpTelnet = 0,
         TlsTelnet = 1,
-        WebSocket = 2
+        WebSocket = 2,
+        UnixTelnet = 3 // telnet over a unix domain socket, from a proxy or gateway on the same host
     };
 
     enum ColorType : uint8_t {
@@ -26,6 +39,12 @@ namespace ring::net {
         TrueColor = 3
     };
 
+    enum CharsetType : uint8_t {
+        Utf8 = 0,
+        Latin1 = 1,
+        Cp437 = 2
+    };
+
     enum TextType : uint8_t {
         Text = 0,
         Line = 1,
@@ -41,25 +60,36 @@ namespace ring::net {
     struct client_details {
         ClientType clientType = TcpTelnet;
         ColorType colorType = NoColor;
+        CharsetType charset = Utf8;
         std::string clientName = "UNKNOWN", clientVersion = "UNKNOWN";
         std::string hostIp = "UNKNOWN", hostName = "UNKNOWN";
-        int width = 78, height = 24;
-        bool utf8 = false, screen_reader = false, proxy = false, osc_color_palette = false;
-        bool vt100 = false, mouse_tracking = false, naws = false, msdp = false, gmcp = false;
-        bool mccp2 = false, mccp2_active = false, mccp3 = false, mccp3_active = false, telopt_eor = false;
-        bool mtts = false, ttype = false, mnes = false, suppress_ga = false, mslp = false;
-        bool force_endline = false, linemode = false, mssp = false, mxp = false, mxp_active = false;
-
+        uint16_t width = 78, height = 24;
+        // who's on the other end of a unix socket, as the kernel reports it. pid 0 for anything else.
+        int32_t peer_pid = 0;
+        uint32_t peer_uid = 0, peer_gid = 0;
+        // capability flags, packed. all start false, see the constructor.
+        bool utf8 : 1, screen_reader : 1, proxy : 1, osc_color_palette : 1;
+        bool vt100 : 1, mouse_tracking : 1, naws : 1, msdp : 1, gmcp : 1;
+        bool mccp2 : 1, mccp2_active : 1, mccp3 : 1, mccp3_active : 1, telopt_eor : 1;
+        bool mtts : 1, ttype : 1, mnes : 1, suppress_ga : 1, mslp : 1;
+        bool force_endline : 1, linemode : 1, mssp : 1, mxp : 1, mxp_active : 1;
+
+        client_details();
         bool isSecure() const;
         bool supportsOOB() const;
+        // what markup should actually be rendered as. screen readers get plain text.
+        ColorType renderColor() const;
         nlohmann::json serialize();
         void load(nlohmann::json &j);
+        // heap held by the strings, beyond their inline storage.
+        std::size_t heapBytes() const;
     };
 
     enum ConnectionEvent {
         CONNECTED = 0,
         DISCONNECTED = 1,
-        TIMEOUT = 2
+        TIMEOUT = 2,
+        THROTTLED = 3
     };
 
     struct ConnectionMsg {
@@ -69,32 +99,85 @@ namespace ring::net {
 
     struct GameMsg {
         std::string command;
-        std::string gmcp;
+        // for GMCP from the client: the package name, with the payload left as it arrived until gmcpData().
+        // command is empty for these.
+        std::string gmcp, gmcp_raw;
         bool mssp;
+        // when the read that finished this line completed, and when the line was queued for the game.
+        latency_clock::time_point received, queued;
+        // parses gmcp_raw. null when there was no payload or it wasn't valid json.
+        nlohmann::json gmcpData() const;
     };
 
-    class MudConnection {
+    class MudConnection : public std::enable_shared_from_this<MudConnection> {
     public:
         MudConnection(std::string &conn_id, boost::asio::io_context &con);
         MudConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j);
+        virtual ~MudConnection() = default;
         virtual void start() = 0;
         virtual void onClose() = 0;
         virtual void sendPrompt(const std::string &txt);
         virtual void sendText(const std::string &txt, TextType mode) = 0;
         virtual void sendLine(const std::string &txt) = 0;
+        virtual void sendMarkup(const color::Markup &m, TextType mode = Line);
         virtual void sendJson(const nlohmann::json &j) = 0;
+        // a cached file from manager.assets, sent as it was rendered for this connection's color tier.
+        virtual void sendAsset(const std::shared_ptr<const static_asset> &asset);
+        // an out-of-band message, e.g. sendGMCP("Char.Vitals", {{"hp", 10}}). dropped for clients without GMCP.
+        virtual void sendGMCP(const std::string &package, const nlohmann::json &data) = 0;
         virtual void sendMSSP(const std::vector<std::tuple<std::string, std::string>> &data) = 0;
         virtual nlohmann::json serialize() = 0;
         virtual void resume() = 0;
+        // sets details.hostName on the strand once a lookup comes back. safe from any thread.
+        void resolvedHost(std::string name);
+        // starts writing whatever was queued while the manager held output back.
+        virtual void releaseOutput();
+        // roughly what this connection costs: the object itself plus everything it owns on the heap.
+        virtual std::size_t memoryFootprint() = 0;
+        // the next line of input, if there is one. games should take input through this rather than
+        // popping game_messages, so the command can be timed through to its answer.
+        bool takeInput(GameMsg &g);
+        // forgets a command the game never answered, so unrelated output later isn't taken for its answer.
+        // call from the game's side: when the next command is taken, or when the tick that took it ends.
+        void dropUnanswered();
+        // coroutine side of the game API. the next line of input, or nothing once the connection is gone.
+        // one reader per connection at a time.
+        boost::asio::awaitable<opt_type<GameMsg>> readLine();
+        // completes once everything sent so far has gone out to the socket, or the connection is gone.
+        boost::asio::awaitable<void> flush();
         std::string conn_id;
         client_details details;
         bool active = true;
-        boost::lockfree::spsc_queue<GameMsg> game_messages;
+        // wrap outgoing text to details.width on the network side.
+        bool word_wrap = false;
+        grow_queue<GameMsg> game_messages;
+        input_throttle throttle;
     protected:
         boost::asio::io_context::strand conn_strand;
+        // readLine() and flush() sleep on this until something changes. only made once one of them is used.
+        std::unique_ptr<boost::asio::steady_timer> wake_timer;
+        // strand only. woken remembers a wake() that came while nothing was waiting, so it isn't lost.
+        bool waiting = false, woken = false;
+        // wakes whatever is waiting in readLine() or flush() to check again. safe from any thread, and
+        // from the close paths: the wake doesn't outlive the connection.
+        void wake();
+        // on the strand: false if there's already been a wake to act on, otherwise sets the timer up to wait on.
+        bool armWake();
+        // nothing queued or in flight on the way out.
+        virtual bool flushed();
+        // the command being timed, as latency_clock counts: when it was read, taken by the game, and
+        // answered. one command at a time; 0 when there isn't one.
+        std::atomic<latency_clock::rep> trace_read{0}, trace_taken{0}, trace_answered{0};
+        // call as output is queued, and once everything queued has been written.
+        void noteOutput();
+        void noteFlushed();
         virtual void loadJson(nlohmann::json &j);
+        // heap bytes held by this layer and the ones below it.
+        virtual std::size_t heapBytes();
     };
 
+    std::size_t stringHeap(const std::string &s);
+
 }
 
 
@@ -0,0 +1,39 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_GMCP_H
+#define RINGNET_GMCP_H
+
+#include "sysdeps.h"
+#include <set>
+#include <shared_mutex>
+#include <string_view>
+
+namespace ring::net {
+
+    // splits "Package.Name {json}" at the first space. data is empty when there's no payload.
+    void splitGMCP(std::string_view msg, std::string_view &package, std::string_view &data);
+
+    // Which inbound GMCP packages the game wants. Everything else is dropped on the network thread
+    // before it's copied anywhere. Names match case-insensitively, as GMCP has it, and subscribing to
+    // "Char" takes "Char.Vitals", "Char.Items.List" and the rest of the module with it.
+    class gmcp_routes {
+    public:
+        void subscribe(const std::string &package);
+        void unsubscribe(const std::string &package);
+        // the package or one of the modules above it was subscribed to.
+        bool wants(std::string_view package);
+        std::vector<std::string> subscribed();
+    protected:
+        struct ci_less {
+            using is_transparent = void;
+            bool operator()(std::string_view a, std::string_view b) const;
+        };
+        std::shared_mutex routes_mutex;
+        std::set<std::string, ci_less> packages;
+    };
+
+}
+
+#endif //RINGNET_GMCP_H
@@ -0,0 +1,56 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_HANDLER_ALLOC_H
+#define RINGNET_HANDLER_ALLOC_H
+
+#include "sysdeps.h"
+
+namespace ring::net {
+
+    // A per-thread cache of small blocks for asio completion handlers, so the steady state of reading
+    // and writing never reaches malloc. Blocks are kept in a few size classes; anything bigger, or
+    // anything freed into a class that's already full, goes to the heap as usual. A block freed on
+    // another thread than it was made on just joins that thread's cache.
+    class handler_memory {
+    public:
+        static void *allocate(std::size_t size);
+        static void deallocate(void *p, std::size_t size);
+        // fills the calling thread's cache up front, so its blocks are allocated (and first touched) there.
+        static void warm();
+    };
+
+    // stateless, since the memory is per-thread rather than per-handler.
+    template<typename T>
+    struct handler_allocator {
+        using value_type = T;
+        handler_allocator() noexcept = default;
+        template<typename U> handler_allocator(const handler_allocator<U>&) noexcept {}
+        T *allocate(std::size_t n) { return static_cast<T*>(handler_memory::allocate(sizeof(T) * n)); }
+        void deallocate(T *p, std::size_t n) { handler_memory::deallocate(p, sizeof(T) * n); }
+        template<typename U> bool operator==(const handler_allocator<U>&) const noexcept { return true; }
+        template<typename U> bool operator!=(const handler_allocator<U>&) const noexcept { return false; }
+    };
+
+    // wraps a completion handler so asio takes its operation storage from handler_memory.
+    template<typename Handler>
+    class alloc_handler {
+    public:
+        using allocator_type = handler_allocator<void>;
+        explicit alloc_handler(Handler h) : handler(std::move(h)) {}
+        allocator_type get_allocator() const noexcept { return {}; }
+        template<typename... Args>
+        void operator()(Args&&... args) { handler(std::forward<Args>(args)...); }
+    protected:
+        Handler handler;
+    };
+
+    template<typename Handler>
+    alloc_handler<std::decay_t<Handler>> recycled(Handler &&h) {
+        return alloc_handler<std::decay_t<Handler>>(std::forward<Handler>(h));
+    }
+
+}
+
+#endif //RINGNET_HANDLER_ALLOC_H
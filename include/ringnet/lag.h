@@ -0,0 +1,77 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_LAG_H
+#define RINGNET_LAG_H
+
+#include "handler_alloc.h"
+#include "latency.h"
+
+namespace ring::net {
+
+    // How often the executor is checked, and how late or how long a handler may be before it's
+    // worth a warning. An interval of 0 turns the periodic check off; recording still happens.
+    struct lag_config {
+        std::chrono::milliseconds interval{1000};
+        std::chrono::milliseconds warn_delay{50}, warn_run{20};
+    };
+
+    // What one executor thread has seen. Written by that thread only.
+    struct thread_lag {
+        std::size_t index = 0;
+        latency_histogram delay, run;
+        std::atomic<uint64_t> handlers{0};
+        // worst since the last check, and who it was. the check takes and resets them.
+        std::atomic<uint64_t> window_delay{0}, window_run{0};
+        std::atomic<const char*> delay_tag{nullptr}, run_tag{nullptr};
+        // what the last check found, for serialize().
+        uint64_t last_delay = 0, last_run = 0;
+        const char *last_delay_tag = nullptr, *last_run_tag = nullptr;
+    };
+
+    // Scheduling delay on the executor threads: how long handlers wait between being posted and
+    // running, and how long they then run for, tagged with where they were posted from. Costs two
+    // clock reads per measured handler.
+    class lag_monitor {
+    public:
+        // post to run, for handlers that were posted. tag must be a string literal.
+        void sampleDelay(const char *tag, latency_clock::duration d);
+        void sampleRun(const char *tag, latency_clock::duration d);
+        // takes the worst of each thread since the last check and warns about anything over the limits.
+        void check();
+        nlohmann::json serialize();
+        lag_config config;
+        bool enabled = true;
+    protected:
+        std::mutex list_mutex;
+        std::vector<std::unique_ptr<thread_lag>> threads;
+        thread_lag *local();
+    };
+
+    extern lag_monitor lag;
+
+    // Times whatever runs in its scope as one handler. With a post time, also how long it waited.
+    class lag_scope {
+    public:
+        explicit lag_scope(const char *tag, latency_clock::time_point posted = {});
+        ~lag_scope();
+    protected:
+        const char *tag;
+        latency_clock::time_point began;
+    };
+
+    // wraps a handler about to be posted so the monitor sees how long it waited and ran. recycled,
+    // like the handlers it replaces.
+    template<typename Handler>
+    auto timed(const char *tag, Handler &&h) {
+        auto posted = lag.enabled ? latency_clock::now() : latency_clock::time_point{};
+        return recycled([tag, posted, h = std::forward<Handler>(h)]() mutable {
+            lag_scope scope(tag, posted);
+            h();
+        });
+    }
+
+}
+
+#endif //RINGNET_LAG_H
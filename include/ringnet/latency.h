@@ -0,0 +1,67 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_LATENCY_H
+#define RINGNET_LATENCY_H
+
+#include "sysdeps.h"
+#include <chrono>
+#include "nlohmann/json.hpp"
+
+namespace ring::net {
+
+    using latency_clock = std::chrono::steady_clock;
+
+    // Where the time between a line being read and its answer leaving the socket went.
+    enum LatencySegment : uint8_t {
+        LatencyNetIn = 0, // read completion to the line being queued for the game
+        LatencyQueue = 1, // queued to the game taking it
+        LatencyGame = 2, // taken to the first output the game sent back
+        LatencyNetOut = 3, // that output to the socket write finishing
+        LatencyTotal = 4, // read completion to the socket write finishing
+        LatencySegments = 5
+    };
+
+    // A log-linear histogram of nanoseconds, in the manner of HDR histograms: exact below 64, and
+    // 32 buckets per power of two above that, so any value is reported to within about 3%.
+    // One thread records, any thread may read.
+    class latency_histogram {
+    public:
+        static constexpr std::size_t sub_buckets = 32;
+        // up to 2^40ns, about 18 minutes. anything longer is counted there.
+        static constexpr std::size_t bucket_count = 2 * sub_buckets + 34 * sub_buckets;
+        void record(uint64_t ns);
+        // adds this histogram's counts into totals.
+        void addTo(std::array<uint64_t, bucket_count> &totals) const;
+        static std::size_t bucketFor(uint64_t ns);
+        // the middle of the range a bucket covers.
+        static uint64_t valueOf(std::size_t bucket);
+        // the value at fraction p of the way through merged counts, or 0 if there are none.
+        static uint64_t percentile(const std::array<uint64_t, bucket_count> &totals, uint64_t count, double p);
+    protected:
+        std::array<std::atomic<uint64_t>, bucket_count> counts{};
+    };
+
+    // Per-thread histograms for every segment, merged when read. Recording never takes a lock
+    // once a thread has its histograms.
+    class latency_tracker {
+    public:
+        void record(LatencySegment segment, latency_clock::duration d);
+        // count and p50/p90/p99/p99.9/max in microseconds for each segment.
+        nlohmann::json serialize();
+        bool enabled = true;
+    protected:
+        struct thread_histograms {
+            std::array<latency_histogram, LatencySegments> segments;
+        };
+        std::mutex list_mutex;
+        std::vector<std::unique_ptr<thread_histograms>> threads;
+        thread_histograms *local();
+    };
+
+    extern latency_tracker latency;
+
+}
+
+#endif //RINGNET_LATENCY_H
@@ -10,55 +10,138 @@
 #include "boost/asio.hpp"
 #include "nlohmann/json.hpp"
 #include "telnet.h"
+#include "admission.h"
+#include "resolver.h"
+#include "portal.h"
+#include "scheduler.h"
+#include "capture.h"
+#include "affinity.h"
+#include "gmcp.h"
+#include "asset.h"
 
 
 namespace ring::net {
 
     class ListenManager;
 
-    struct plain_telnet_listen {
-        plain_telnet_listen(ListenManager &man, boost::asio::ip::tcp::endpoint endp);
-        plain_telnet_listen(ListenManager &man, boost::asio::ip::tcp prot, int socket);
-        boost::asio::ip::tcp::acceptor acceptor;
-        telnet::TcpMudTelnetConnection* queued_connection;
+    // how a socket's address family is written down for a copyover: 4, 6, or 0 for a unix socket. and back again.
+    int familyCode(int family);
+    boost::asio::generic::stream_protocol protocolFor(int code);
+    using stream_acceptor = boost::asio::basic_socket_acceptor<boost::asio::generic::stream_protocol>;
+
+    // A telnet listener on a TCP port or, with path set, a unix domain socket.
+    struct plain_telnet_listen : public uring_target {
+        plain_telnet_listen(ListenManager &man, boost::asio::generic::stream_protocol::endpoint endp);
+        plain_telnet_listen(ListenManager &man, boost::asio::generic::stream_protocol prot, int socket);
+        stream_acceptor acceptor;
         ListenManager &manager;
         boost::asio::io_context::strand listen_strand;
+        // used to back off when we've run out of descriptors.
+        boost::asio::steady_timer backoff_timer;
+        std::chrono::milliseconds backoff{0};
         bool isListening = false;
+        // connections arrive through a load balancer and open with a PROXY protocol header.
+        bool proxy_protocol = false;
+        // where a unix socket listener is bound. empty for TCP.
+        std::string path;
 
         void listen();
         void do_listen();
-        void do_accept(std::error_code ec);
+        void do_accept(boost::system::error_code ec);
+        // takes an accepted descriptor through admission and into a connection. closes it if refused.
+        void adopt(int fd);
+        void accepted(telnet::TcpMudTelnetConnection *conn);
+        // true if the error was descriptor or memory exhaustion, in which case accepting is paused for a while.
+        bool exhausted(int err);
+        void onUringAccept(int res, bool more) override;
     };
 
 
     class ListenManager {
     public:
         ListenManager();
+        ~ListenManager();
         bool readyTLS();
-        bool listenPlainTelnet(const std::string& ip, uint16_t port);
+        // switches socket I/O over to io_uring. returns false and stays on the reactor if the kernel can't do it.
+        // call before listening or recovering from a copyover.
+        bool enableIoUring();
+        std::unique_ptr<uring_backend> uring;
+        // hands events and input to a game in another process over shared memory, and takes its output back.
+        // the portal thread becomes the consumer of events, so the game must not pop them itself.
+        bool enablePortal(const std::string &name, uint64_t capacity = 1 << 20);
+        std::unique_ptr<portal_server> portal;
+        bool listenPlainTelnet(const std::string& ip, uint16_t port, bool proxy = false);
+        // telnet over a unix domain socket, for proxies and gateways on the same host. a stale socket
+        // file left at path is replaced. connections carry the peer's pid, uid and gid in their details.
+        bool listenUnixTelnet(const std::string &path, bool proxy = false);
         bool listenTLSTelnet(const std::string& ip, uint16_t port);
         bool listenWebSocket(const std::string& ip, uint16_t port);
         std::set<std::string> conn_ids;
         std::unordered_map<std::string, std::shared_ptr<MudConnection>> connections;
         std::mutex conn_mutex, id_mutex;
         void closeConn(std::string &conn_id);
+        // starts the wheels and the resolver, once. run(), poll() and the tick scheduler all call it.
+        void start();
         void run(int threads = 0);
+        // CPU placement for the executor threads run() starts, including the one that calls it.
+        affinity_config affinity;
+        thread_placement placement;
+        // moves the calling thread onto affinity.game_cpu. false if there isn't one or it can't be used.
+        bool pinGame();
+        // runs whatever network work is ready on the calling thread, for at most budget. for games that
+        // keep their own loop. returns how many handlers ran.
+        std::size_t poll(std::chrono::microseconds budget);
+        // bulk text a connection may have queued and not yet written, in bytes. sends past it are dropped.
+        std::size_t output_limit = 4 << 20;
+        telnet::output_stats output;
+        // raw socket traffic to a trace file, for replaying later. off until opened.
+        io_capture capture;
         nlohmann::json copyover();
         std::vector<std::thread> threads;
         void copyoverRecover(nlohmann::json &json);
         nlohmann::json serialize();
+        // what the live connections are costing us, in total and per connection.
+        nlohmann::json memoryReport();
         bool running = true;
         boost::asio::io_context executor;
+        // checks the executor threads for lag every lag.config.interval, starting with start().
+        std::unique_ptr<boost::asio::steady_timer> lag_timer;
         boost::lockfree::spsc_queue<ConnectionMsg> events;
+        // applied to every new connection.
+        throttle_config throttle_limits;
+        // checked against the remote address of every accepted socket.
+        admission_config admission_limits;
+        admission_control admission;
+        // most connections taken off a listener's backlog per wakeup.
+        std::size_t accept_batch = 32;
+        // reverse lookups for new connections. the pool starts with run().
+        bool resolve_hostnames = true;
+        resolver_config dns;
+        hostname_resolver resolver;
+        // fills in details.hostName for the connection once the lookup comes back.
+        void lookupHost(const std::string &conn_id, const boost::asio::ip::address &addr);
+        // static text files, rendered once and shared by every connection they're sent to.
+        asset_cache assets;
+        // inbound GMCP packages to pass on. empty, which is the default, drops all of it.
+        gmcp_routes gmcp;
+        timeout_config timeouts;
+        bool word_wrap = false;
         std::unordered_map<uint16_t, std::unique_ptr<plain_telnet_listen>> plain_telnet_listeners;
+        std::unordered_map<std::string, std::unique_ptr<plain_telnet_listen>> unix_telnet_listeners;
+        // one wheel per executor thread. connections are spread across them by id.
+        std::vector<std::unique_ptr<timing_wheel>> wheels;
+        timing_wheel& wheelFor(const std::string &conn_id);
     protected:
-
+        std::once_flag start_once;
+        void checkLag();
         std::unordered_set<uint16_t> ports;
         boost::asio::ip::address parse_addr(const std::string& ip);
         boost::asio::ip::tcp::endpoint create_endpoint(const std::string& ip, uint16_t port);
         nlohmann::json serializePlainTelnetListeners();
+        nlohmann::json serializeUnixTelnetListeners();
         nlohmann::json serializeConnections();
         void loadPlainTelnetListeners(nlohmann::json &j);
+        void loadUnixTelnetListeners(nlohmann::json &j);
         void loadConnections(nlohmann::json &j);
         void loadPlainTelnet(nlohmann::json &j);
         void loadTlsTelnet(nlohmann::json &j);
@@ -68,6 +151,9 @@ namespace ring::net {
     std::string generate_id(const std::string &prf, std::size_t length, std::set<std::string> &existing);
 
     extern ListenManager manager;
+    // set on the game thread while the tick scheduler runs a tick: its sends are queued and written
+    // together once the tick is over. negotiation and keepalives from the network threads aren't held.
+    extern thread_local bool hold_output;
 
 }
 
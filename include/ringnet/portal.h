@@ -0,0 +1,135 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_PORTAL_H
+#define RINGNET_PORTAL_H
+
+#include "connection.h"
+#include "gmcp.h"
+#include <string_view>
+
+namespace ring::net {
+
+    class ListenManager;
+
+    // What travels between the portal (the process holding the sockets) and the game.
+    enum PortalRecord : uint8_t {
+        PortalPad = 0, // filler up to the end of the ring, never delivered
+        PortalHello = 1, // game -> portal: just attached. body is the game's generation
+        PortalResyncBegin = 2, // portal -> game: answer to a hello. body is the generation it answers
+        PortalResyncEnd = 3,
+        PortalEvent = 4, // portal -> game: extra is the ConnectionEvent
+        PortalDetails = 5, // portal -> game: body is the client_details json
+        PortalInput = 6, // portal -> game: body is a line of input
+        PortalOutput = 7, // game -> portal: extra is the TextType, body the text
+        PortalClose = 8, // game -> portal: drop the connection
+        PortalGMCP = 9 // portal -> game: body is the GMCP message as the client sent it, package first
+    };
+
+    struct portal_message {
+        PortalRecord type = PortalPad;
+        uint8_t extra = 0;
+        std::string conn_id, body;
+    };
+
+    struct shm_ring_header {
+        // each side only writes its own counter, and they live on separate cache lines.
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) uint64_t capacity;
+    };
+
+    // A single producer, single consumer ring of records in shared memory. Records are 8 byte aligned
+    // and never wrap: one that won't fit before the end is preceded by a pad record and starts at the front.
+    class shm_ring {
+    public:
+        static std::size_t footprint(uint64_t capacity);
+        void bind(void *memory, uint64_t capacity, bool init);
+        // false if there isn't room. nothing is written in that case.
+        bool write(PortalRecord type, uint8_t extra, std::string_view conn_id, std::string_view body);
+        bool read(portal_message &msg);
+        // consumer side: skip everything that's been written so far.
+        void discard();
+        uint64_t used() const;
+    protected:
+        shm_ring_header *header = nullptr;
+        uint8_t *data = nullptr;
+    };
+
+    // The mapped segment: a small header and a ring in each direction. The portal creates it,
+    // the game attaches to it, and it outlives any number of game processes.
+    class portal_segment {
+    public:
+        ~portal_segment();
+        bool create(const std::string &name, uint64_t capacity);
+        bool attach(const std::string &name);
+        void close();
+        shm_ring to_game, to_portal;
+        std::atomic<uint64_t> *game_generation = nullptr;
+    protected:
+        std::string name;
+        void *memory = nullptr;
+        std::size_t size = 0;
+        bool owner = false;
+        void bindRings(bool init);
+    };
+
+    struct portal_stats {
+        std::atomic<uint64_t> records_out{0}, records_in{0}, dropped{0}, resyncs{0};
+        nlohmann::json serialize() const;
+    };
+
+    // Portal side. Runs on a thread of its own: forwards connection events and input to the game,
+    // and applies the game's output and closes to the connections. When a game (re)attaches it gets
+    // the full list of connections again, so a restarted game picks up every player where they are.
+    class portal_server {
+    public:
+        explicit portal_server(ListenManager &man);
+        ~portal_server();
+        bool open(const std::string &name, uint64_t capacity);
+        void start();
+        void stop();
+        // called from the network threads for every line of input. false if the ring was full.
+        bool input(const std::string &conn_id, const std::string &line);
+        // the same for GMCP the network threads let through. the game splits it with splitGMCP().
+        bool gmcp(const std::string &conn_id, const std::string &package, const std::string &data);
+        portal_stats stats;
+    protected:
+        ListenManager &manager;
+        portal_segment segment;
+        std::mutex write_mutex;
+        std::thread worker;
+        std::atomic<bool> running{false};
+        // something the game needed to know about connections didn't fit. the next pump() sends it
+        // everything again rather than leave it short a player, or holding on to one that's gone.
+        std::atomic<bool> resync_pending{false};
+        // the generation of the last hello, for resyncs the game didn't ask for. worker thread only.
+        uint64_t game_generation = 0;
+        bool send(PortalRecord type, uint8_t extra, std::string_view conn_id, std::string_view body);
+        void run();
+        bool pump();
+        void resync(uint64_t generation);
+        void sendConnection(const std::string &conn_id, MudConnection &conn);
+        void handle(const portal_message &msg);
+    };
+
+    // Game side. Everything here is meant for one game thread.
+    class portal_client {
+    public:
+        bool attach(const std::string &name);
+        // next message from the portal. records left over from before this attach are skipped.
+        bool poll(portal_message &msg);
+        bool send(const std::string &conn_id, const std::string &txt, TextType mode = Line);
+        bool close(const std::string &conn_id);
+        // true until the portal has answered our hello.
+        bool resyncing() const;
+    protected:
+        portal_segment segment;
+        uint64_t generation = 0;
+        bool synced = false;
+    };
+
+}
+
+#endif //RINGNET_PORTAL_H
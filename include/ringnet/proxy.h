@@ -0,0 +1,33 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_PROXY_H
+#define RINGNET_PROXY_H
+
+#include "sysdeps.h"
+#include "boost/asio.hpp"
+
+namespace ring::net {
+
+    enum ProxyResult : uint8_t {
+        ProxyIncomplete = 0, // not enough bytes yet
+        ProxyDone = 1,
+        ProxyInvalid = 2 // not a PROXY header at all, or a broken one
+    };
+
+    struct proxy_header {
+        // a LOCAL header (v2) or UNKNOWN (v1) carries no addresses: the proxy talking for itself, like a health check.
+        bool local = false;
+        boost::asio::ip::address source, destination;
+        uint16_t source_port = 0, destination_port = 0;
+        // bytes the header took up, to be consumed before the telnet stream begins.
+        std::size_t length = 0;
+    };
+
+    // Parses a PROXY protocol v1 or v2 header off the front of the stream.
+    ProxyResult parseProxyHeader(const uint8_t *data, std::size_t length, proxy_header &out);
+
+}
+
+#endif //RINGNET_PROXY_H
@@ -0,0 +1,87 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_QUEUE_H
+#define RINGNET_QUEUE_H
+
+#include "sysdeps.h"
+
+namespace ring::net {
+
+    // A bounded FIFO that owns no storage until something is pushed, grows by doubling up to its limit,
+    // and gives the memory back once it drains. Same push/pop surface as the lockfree spsc_queue it replaces,
+    // but an idle connection pays for a mutex and an empty vector instead of a preallocated ring.
+    template<typename T>
+    class grow_queue {
+    public:
+        explicit grow_queue(std::size_t limit) : limit(limit) {}
+
+        bool push(const T &item) {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            if(!reserveOne()) return false;
+            ring[(head + count) % ring.size()] = item;
+            count++;
+            return true;
+        }
+
+        bool push(T &&item) {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            if(!reserveOne()) return false;
+            ring[(head + count) % ring.size()] = std::move(item);
+            count++;
+            return true;
+        }
+
+        bool pop(T &item) {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            if(!count) return false;
+            item = std::move(ring[head]);
+            head = (head + 1) % ring.size();
+            if(!--count) {
+                // drained. hand the storage back rather than keep it around for the next burst.
+                std::vector<T>().swap(ring);
+                head = 0;
+            }
+            return true;
+        }
+
+        bool empty() {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            return !count;
+        }
+
+        std::size_t read_available() {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            return count;
+        }
+
+        std::size_t write_available() {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            return limit - count;
+        }
+
+        std::size_t capacity() {
+            std::lock_guard<std::mutex> guard(queue_mutex);
+            return ring.capacity();
+        }
+
+    protected:
+        std::mutex queue_mutex;
+        std::vector<T> ring;
+        std::size_t head = 0, count = 0, limit;
+
+        bool reserveOne() {
+            if(count < ring.size()) return true;
+            if(count >= limit) return false;
+            std::vector<T> bigger(std::min(limit, std::max<std::size_t>(4, ring.size() * 2)));
+            for(std::size_t i = 0; i < count; i++) bigger[i] = std::move(ring[(head + i) % ring.size()]);
+            ring.swap(bigger);
+            head = 0;
+            return true;
+        }
+    };
+
+}
+
+#endif //RINGNET_QUEUE_H
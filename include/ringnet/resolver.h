@@ -0,0 +1,59 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_RESOLVER_H
+#define RINGNET_RESOLVER_H
+
+#include "admission.h"
+#include <chrono>
+
+namespace ring::net {
+
+    // Address to hostname. Returns an empty string when there's no name to be had.
+    using lookup_function = std::function<std::string(const boost::asio::ip::address &addr)>;
+
+    // The default lookup: getnameinfo(), so /etc/hosts and nsswitch apply.
+    std::string lookupHostname(const boost::asio::ip::address &addr);
+
+    struct resolver_config {
+        unsigned threads = 2;
+        std::size_t cache_size = 4096;
+        // failures are cached too, but not for as long, so a flaky nameserver doesn't stick.
+        std::chrono::seconds ttl{3600}, negative_ttl{300};
+    };
+
+    // Reverse lookups on a small pool of their own, so a slow nameserver never stalls the network threads.
+    // Results are kept in an LRU with a TTL shared by every connection, and lookups for an address that's
+    // already being resolved wait on that one instead of starting another.
+    class hostname_resolver {
+    public:
+        using callback = std::function<void(const std::string &name)>;
+        ~hostname_resolver();
+        void start(const resolver_config &cfg);
+        void stop();
+        // done runs on a resolver thread, or right away on a cache hit. an empty name means none was found.
+        void resolve(const boost::asio::ip::address &addr, callback done);
+        opt_type<std::string> cached(const boost::asio::ip::address &addr);
+        // replace before start() to use something other than getnameinfo(), like a stub for testing.
+        lookup_function lookup = lookupHostname;
+    protected:
+        struct entry {
+            address_key key;
+            std::string name;
+            std::chrono::steady_clock::time_point expires;
+        };
+        resolver_config config;
+        std::unique_ptr<boost::asio::thread_pool> pool;
+        std::mutex resolver_mutex;
+        std::list<entry> order;
+        std::unordered_map<address_key, std::list<entry>::iterator, address_key_hash> index;
+        std::unordered_map<address_key, std::vector<callback>, address_key_hash> pending;
+        bool find(const address_key &key, std::string &name);
+        void store(const address_key &key, const std::string &name);
+        void finish(const address_key &key, const std::string &name);
+    };
+
+}
+
+#endif //RINGNET_RESOLVER_H
@@ -0,0 +1,62 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_SCHEDULER_H
+#define RINGNET_SCHEDULER_H
+
+#include "connection.h"
+#include <chrono>
+
+namespace ring::net {
+
+    class ListenManager;
+
+    using tick_clock = std::chrono::steady_clock;
+
+    // How often the game ticks. If it falls more than max_catchup ticks behind, the missed ones
+    // are dropped rather than run back to back.
+    struct tick_config {
+        std::chrono::milliseconds interval{100};
+        std::size_t max_catchup = 5;
+    };
+
+    // Everything the network collected since the last tick, handed to the game in one go.
+    struct game_tick {
+        uint64_t number = 0;
+        tick_clock::time_point started;
+        std::vector<ConnectionMsg> events;
+        std::vector<std::pair<std::shared_ptr<MudConnection>, GameMsg>> input;
+    };
+
+    struct tick_stats {
+        std::atomic<uint64_t> ticks{0}, overruns{0}, skipped{0};
+        // how long the last tick and the slowest one took, drain to flush.
+        std::atomic<uint64_t> last_us{0}, max_us{0};
+        nlohmann::json serialize() const;
+    };
+
+    // Runs the game at a fixed timestep on the calling thread. Each tick drains events and input,
+    // calls the game, and then lets out everything the game sent at once. Network work happens on
+    // its own threads, or with none, on the game thread in between ticks.
+    class tick_scheduler {
+    public:
+        using tick_function = std::function<void(game_tick&)>;
+        explicit tick_scheduler(ListenManager &man);
+        // blocks until stop() or a copyover.
+        void run(const tick_config &cfg, tick_function fn, int threads = 0);
+        // safe from anywhere, the game callback included.
+        void stop();
+        tick_stats stats;
+    protected:
+        ListenManager &manager;
+        std::atomic<bool> running{false};
+        game_tick current;
+        void tick(const tick_function &fn);
+        void collect();
+        void release();
+    };
+
+}
+
+#endif //RINGNET_SCHEDULER_H
@@ -19,6 +19,7 @@
 #include <atomic>
 #include <iostream>
 #include <thread>
+#include <utility>
 
 #if __has_include(<filesystem>)
 #include <filesystem>
@@ -6,38 +6,76 @@
 #define RINGMUD_TELNET_H
 
 #include "connection.h"
+#include "timing.h"
+#include "uring.h"
+#include "capture.h"
+#include <array>
 
 namespace ring::telnet {
 
     namespace codes {
-        extern const uint8_t NUL;
-        extern const uint8_t BEL;
-        extern const uint8_t CR;
-        extern const uint8_t LF;
-        extern const uint8_t SGA;
-        extern const uint8_t TELOPT_EOR;
-        extern const uint8_t NAWS;
-        extern const uint8_t LINEMODE;
-        extern const uint8_t EOR;
-        extern const uint8_t SE;
-        extern const uint8_t NOP;
-        extern const uint8_t GA;
-        extern const uint8_t SB;
-        extern const uint8_t WILL;
-        extern const uint8_t WONT;
-        extern const uint8_t DO;
-        extern const uint8_t DONT;
-        extern const uint8_t IAC;
-
-        extern const uint8_t MNES;
-        extern const uint8_t MXP;
-        extern const uint8_t MSSP;
-        extern const uint8_t MCCP2;
-        extern const uint8_t MCCP3;
-
-        extern const uint8_t GMCP;
-        extern const uint8_t MSDP;
-        extern const uint8_t MTTS;
+        inline constexpr uint8_t NUL = 0;
+        inline constexpr uint8_t BEL = 7;
+        inline constexpr uint8_t CR = 13;
+        inline constexpr uint8_t LF = 10;
+        inline constexpr uint8_t SGA = 3;
+        inline constexpr uint8_t TELOPT_EOR = 25;
+        inline constexpr uint8_t NAWS = 31;
+        inline constexpr uint8_t LINEMODE = 34;
+        inline constexpr uint8_t EOR = 239;
+        inline constexpr uint8_t SE = 240;
+        inline constexpr uint8_t NOP = 241;
+        inline constexpr uint8_t GA = 249;
+        inline constexpr uint8_t SB = 250;
+        inline constexpr uint8_t WILL = 251;
+        inline constexpr uint8_t WONT = 252;
+        inline constexpr uint8_t DO = 253;
+        inline constexpr uint8_t DONT = 254;
+        inline constexpr uint8_t IAC = 255;
+
+        inline constexpr uint8_t MNES = 39;
+        inline constexpr uint8_t MXP = 91;
+        inline constexpr uint8_t MSSP = 70;
+        inline constexpr uint8_t MCCP2 = 86;
+        inline constexpr uint8_t MCCP3 = 87;
+
+        inline constexpr uint8_t GMCP = 201;
+        inline constexpr uint8_t MSDP = 69;
+        inline constexpr uint8_t MTTS = 24;
+    }
+
+    namespace options {
+        enum OptionFlags : uint8_t {
+            SupportLocal = 1,
+            SupportRemote = 2,
+            StartWill = 4,
+            StartDo = 8
+        };
+
+        // every option we have a handler for, in slot order.
+        inline constexpr std::array<uint8_t, 6> supported = {codes::MSSP, codes::SGA, codes::MSDP, codes::GMCP,
+                                                             codes::NAWS, codes::MTTS};
+        inline constexpr uint8_t no_slot = 0xFF;
+
+        inline constexpr std::array<uint8_t, 256> flags = [] {
+            using namespace codes;
+            std::array<uint8_t, 256> t{};
+            t[MSSP] = SupportLocal | StartWill;
+            t[SGA] = SupportLocal | StartWill;
+            t[MSDP] = SupportLocal | StartWill;
+            t[GMCP] = SupportLocal | StartWill;
+            t[NAWS] = SupportRemote | StartDo;
+            t[MTTS] = SupportRemote | StartDo;
+            return t;
+        }();
+
+        // option code -> index into the connection's handler array, or no_slot.
+        inline constexpr std::array<uint8_t, 256> slots = [] {
+            std::array<uint8_t, 256> t{};
+            for(auto &s : t) s = no_slot;
+            for(std::size_t i = 0; i < supported.size(); i++) t[supported[i]] = i;
+            return t;
+        }();
     }
 
     class MudTelnetConnection;
@@ -59,6 +97,80 @@ namespace ring::telnet {
 
     opt_type<TelnetMessage> parse_message(boost::asio::streambuf &buf);
 
+    // How text is put on the wire: newlines become CRLF, stray CRs are dropped and IAC is doubled.
+    // A policy rather than a virtual, so frameText() inlines the per-byte loop.
+    struct telnet_framing {
+        static void append(std::vector<uint8_t> &out, std::string_view src) {
+            for(auto c : src) {
+                switch(static_cast<uint8_t>(c)) {
+                    case codes::CR:
+                        break;
+                    case codes::LF:
+                        out.push_back(codes::CR);
+                        out.push_back(codes::LF);
+                        break;
+                    case codes::IAC:
+                        out.push_back(codes::IAC);
+                        out.push_back(codes::IAC);
+                        break;
+                    default:
+                        out.push_back(c);
+                        break;
+                }
+            }
+        }
+        static void endLine(std::vector<uint8_t> &out) {
+            out.push_back(codes::CR);
+            out.push_back(codes::LF);
+        }
+        static void endPrompt(std::vector<uint8_t> &out, bool eor) {
+            out.push_back(codes::IAC);
+            out.push_back(eor ? codes::EOR : codes::GA);
+        }
+    };
+
+    // Text to wire bytes in one pass and one allocation. A Line ends with a line break unless it already
+    // does, or always with force_break. A Prompt ends with GA, or EOR when the client asked for it.
+    template<typename Framing = telnet_framing>
+    std::vector<uint8_t> frameText(std::string_view src, net::TextType mode, bool eor, bool force_break = false) {
+        std::vector<uint8_t> out;
+        out.reserve(src.size() + src.size() / 32 + 4);
+        Framing::append(out, src);
+        if(mode == net::Line && (force_break || src.empty() || src.back() != '\n')) Framing::endLine(out);
+        if(mode == net::Prompt) Framing::endPrompt(out, eor);
+        return out;
+    }
+
+    // Output waits in one of these until it's written. The writer always takes from the earlier lanes
+    // first, so a prompt or a GMCP update never queues behind more than one write of bulk text.
+    enum OutputLane : uint8_t {
+        LaneInteractive = 0, // prompts and telnet negotiation
+        LaneOOB = 1, // GMCP and MSDP
+        LaneBulk = 2, // everything else the game sends
+        LaneCount = 3
+    };
+
+    // Sends thrown away rather than queued, across every connection. Only bulk text is ever dropped,
+    // once a connection is over manager.output_limit; prompts, GMCP and negotiation always queue.
+    struct output_stats {
+        std::atomic<uint64_t> sends_dropped{0}, bytes_dropped{0};
+        nlohmann::json serialize() const;
+    };
+
+    // One send waiting in a lane: either bytes of its own, or a share of an immutable buffer that
+    // other connections may be sending from too, like a cached asset.
+    struct out_chunk {
+        out_chunk() = default;
+        out_chunk(std::vector<uint8_t> bytes) : owned(std::move(bytes)) {}
+        out_chunk(std::shared_ptr<const std::vector<uint8_t>> buf) : shared(std::move(buf)) {}
+        std::vector<uint8_t> owned;
+        std::shared_ptr<const std::vector<uint8_t>> shared;
+        // prompts and GMCP only: how many bulk bytes had been queued ahead of it. it may not pass those
+        // unless they're beyond the write quantum it goes out in.
+        uint64_t mark = 0;
+        const std::vector<uint8_t> &bytes() const { return shared ? *shared : owned; }
+    };
+
     struct TelnetOptionPerspective {
         bool enabled = false, negotiating = false, answered = false;
     };
@@ -76,11 +188,10 @@ namespace ring::telnet {
         uint8_t code;
         void load(nlohmann::json& j);
         nlohmann::json serialize() const;
-        std::string mtts_last;
     protected:
         MudTelnetConnection *conn;
-        int mtts_count = 0;
         void subMTTS(const TelnetMessage &msg);
+        void subNAWS(const TelnetMessage &msg);
         void subMTTS_0(const std::string& mtts);
         void subMTTS_1(const std::string& mtts);
         void subMTTS_2(const std::string mtts);
@@ -88,57 +199,169 @@ namespace ring::telnet {
 
 
 class MudTelnetConnection : public ring::net::MudConnection {
+        friend class TelnetOption;
     public:
         MudTelnetConnection(std::string &conn_id, boost::asio::io_context &con);
         MudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j);
+        virtual ~MudTelnetConnection();
         virtual void start() override;
-        virtual void sendBytes(const std::vector<uint8_t>& data) = 0;
+        // takes the bytes by value so callers done with their buffer can move it in rather than copy it.
+        // the bytes must be whole telnet messages: lanes may be interleaved between any two sends.
+        virtual void sendBytes(std::vector<uint8_t> data, OutputLane lane = LaneBulk) = 0;
+        // the same for bytes that are already framed and shared. copies them unless the transport can do better.
+        virtual void sendShared(std::shared_ptr<const std::vector<uint8_t>> data, OutputLane lane = LaneBulk);
+        virtual void sendAsset(const std::shared_ptr<const net::static_asset> &asset) override;
         virtual void sendJson(const nlohmann::json &j) override;
+        virtual void sendGMCP(const std::string &package, const nlohmann::json &data) override;
         virtual void sendPrompt(const std::string &txt) override;
         virtual void sendLine(const std::string &txt) override;
         virtual void sendText(const std::string &txt, net::TextType mode) override;
         virtual void sendMSSP(const std::vector<std::tuple<std::string, std::string>> &data) override;
         virtual nlohmann::json serialize() override;
         virtual void loadJson(nlohmann::json &j) override;
-        void sendSub(const uint8_t op, const std::vector<uint8_t>& data);
+        void sendSub(const uint8_t op, const std::vector<uint8_t>& data, OutputLane lane = LaneInteractive);
         void sendNegotiate(uint8_t command, const uint8_t option);
+        // what every text send comes down to: wrap, transcode and frame, then one sendBytes().
+        void queueText(const std::string &txt, net::TextType mode, bool force_break = false);
         virtual void resume();
+        // runs bytes through the parser as if they had just been read off the socket. for replaying captures.
+        void feed(const uint8_t *data, std::size_t len);
+        // the stream opens with a PROXY protocol header, which has to be read before any telnet.
+        bool expect_proxy = false;
     protected:
         void handleMessage(const TelnetMessage &msg);
         void handleAppData(const TelnetMessage &msg);
         void handleCommand(const TelnetMessage &msg);
         void handleNegotiate(const TelnetMessage &msg);
         void handleSubnegotiate(const TelnetMessage &msg);
+        // GMCP from the client. only packages in the manager's gmcp routes get past the name.
+        void handleGMCP(const TelnetMessage &msg);
+        // hands a finished line or GMCP message to the game, or the portal. counts it as dropped if there's no room.
+        void queueInput(net::GameMsg &g);
         void onDataReceived();
         void onConnect();
         void ready();
-        boost::lockfree::spsc_queue<std::vector<uint8_t>> out_queue;
+        // every WILL and DO we opened with has been answered, and MTTS has told us all it will.
+        bool negotiated() const;
+        // hands the connection to the game as soon as it's negotiated(), rather than at the deadline.
+        void checkReady();
+        void touchInput(), touchOutput();
+        // points the wheel entry at this connection. needs it to be owned already, so not in the constructor.
+        void bindWheel();
+        void armWheel();
+        void onWheel();
+        void expire();
+        // drops it without the game ever having heard of it.
+        void refuse();
+        virtual void disconnect() = 0;
+        std::array<net::grow_queue<out_chunk>, LaneCount> out_lanes;
+        // running total of bulk bytes ever queued, for marking prompts and GMCP with what's ahead of them.
+        std::atomic<uint64_t> bulk_queued{0};
+        // running total of bulk bytes the writer has taken, in step with bulk_queued. only the writer
+        // changes it; the difference is what's still waiting, for the output limit.
+        std::atomic<uint64_t> bulk_taken{0};
+        void queueChunk(out_chunk item, OutputLane lane);
+        // said so in the log the first time this connection's output was dropped.
+        std::atomic<bool> output_dropped{false};
+        // anything queued in any lane.
+        bool queued();
         std::mutex out_mutex;
         std::string app_data;
-        std::unordered_map<uint8_t, TelnetOption> handlers;
-        boost::asio::high_resolution_timer start_timer;
+        // only MTTS needs more than on/off state, so it lives here rather than in every option.
+        std::string mtts_last;
+        uint8_t mtts_count = 0;
+        bool mtts_done = false;
+        // text arrived while negotiation was still going.
+        bool typed = false;
+        std::array<TelnetOption, options::supported.size()> handlers;
+        TelnetOption* option(uint8_t code);
+        net::timing_wheel &wheel;
+        net::wheel_timer wheel_entry;
+        std::atomic<net::wheel_clock::rep> last_input{0}, last_output{0};
+        net::wheel_clock::time_point negotiate_deadline;
+        // a PROXY header that hasn't arrived by now isn't coming.
+        net::wheel_clock::time_point proxy_deadline;
+        bool ready_sent = false;
+        // when the last read finished. lines completed by it are timed from here.
+        net::latency_clock::time_point read_at;
         boost::asio::streambuf in_buffer, out_buffer;
         nlohmann::json serializeHandlers();
+        std::size_t heapBytes() override;
     };
 
-    class TcpMudTelnetConnection : public MudTelnetConnection {
+    // final, so everything it calls on itself binds statically. the game still reaches it through MudConnection.
+    class TcpMudTelnetConnection final : public MudTelnetConnection, public net::uring_target {
     public:
         TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con);
-        TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j, boost::asio::ip::tcp prot, int socket);
-        boost::asio::ip::tcp::socket _socket;
+        TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, boost::asio::generic::stream_protocol prot, int socket);
+        TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j, boost::asio::generic::stream_protocol prot, int socket);
+        ~TcpMudTelnetConnection() override;
+        // generic, so the same connection serves TCP and unix domain sockets.
+        boost::asio::generic::stream_protocol::socket _socket;
+        // the address this connection counts against in the manager's admission control, if it does.
+        boost::asio::ip::address peer;
+        bool admitted = false;
+        // this connection's number in the manager's capture. 0 until it first shows up in one.
+        uint32_t capture_id = 0;
         virtual nlohmann::json serialize() override;
         virtual void start() override;
-        virtual void sendBytes(const std::vector<uint8_t> &data) override;
+        virtual void sendBytes(std::vector<uint8_t> data, OutputLane lane = LaneBulk) override;
+        virtual void sendShared(std::shared_ptr<const std::vector<uint8_t>> data, OutputLane lane = LaneBulk) override;
         virtual void resume() override;
         virtual void onClose() override;
+        void releaseOutput() override;
+        std::size_t memoryFootprint() override;
+        void onUringRecv(int res, const uint8_t *data, std::size_t len, bool more) override;
+        void onUringSend(int res) override;
     protected:
-        bool isWriting = false;
+        virtual void disconnect() override;
+        bool flushed() override;
+        std::atomic<bool> isWriting{false};
+        std::unique_ptr<boost::asio::steady_timer> throttle_timer;
         void read();
+        // on the reactor, reading is one coroutine for the life of the connection.
+        // io_uring completions come back through onUringRecv instead.
+        boost::asio::awaitable<void> readLoop();
+        // io_uring reads arrive on whichever thread drains the ring. they're set aside here, and the strand
+        // takes them in uringReceived(), so the parser only ever runs there. one post covers any number.
+        std::mutex uring_in_mutex;
+        std::vector<uint8_t> uring_in, uring_taking;
+        bool uring_in_posted = false;
+        void uringReceived(int res, bool more);
+        void received(const uint8_t *data, std::size_t len);
+        // takes in what was just read into in_buffer. false if reading should stop.
+        bool consume(std::size_t trans);
+        void onReadError(boost::system::error_code ec);
+        void capture(net::CaptureKind kind, const uint8_t *data, std::size_t len);
+        // false if the header isn't all here yet or was refused.
+        bool readProxyHeader();
+        // how long reading should hold off, if at all. enters or leaves the throttle to match.
+        net::throttle_clock::duration readDelay();
+        void continueRead();
+        void throttleRead(net::throttle_clock::duration wait);
         void write();
-        void do_read(boost::system::error_code ec, std::size_t trans);
+        void writeSome();
+        void detachUring();
         void do_write(boost::system::error_code ec, std::size_t trans);
         void real_write();
+        // tops out_buffer up from the lanes with at most budget bytes of bulk text. a prompt or GMCP
+        // message goes behind the bulk queued before it if that fits in the budget, and overtakes it if
+        // not. false if there was nothing to add. under out_mutex.
+        bool fillOutput(std::size_t budget, bool allow_direct);
+        // up to want bytes of bulk into out_buffer, or into a direct write. true if it set up a direct write.
+        bool takeBulk(std::size_t want, bool allow_direct);
+        // the head of each priority lane, popped to compare marks. under out_mutex.
+        std::array<opt_type<out_chunk>, LaneBulk> held;
+        // everything queued into out_buffer regardless of lanes, for a copyover.
         void flush_out_queue();
+        // the part of a big bulk send that didn't fit in the last quantum. under out_mutex.
+        out_chunk bulk_rest;
+        std::size_t bulk_offset = 0;
+        // when non-zero, the write in flight is this many bytes straight out of bulk_rest's shared buffer
+        // at bulk_offset, rather than out of out_buffer.
+        std::size_t direct = 0;
+        // where the write in flight starts.
+        const uint8_t *writing();
     };
 
 }
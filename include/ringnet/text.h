@@ -0,0 +1,31 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_TEXT_H
+#define RINGNET_TEXT_H
+
+#include "sysdeps.h"
+#include <string_view>
+
+namespace ring::text {
+
+    // Length of the leading run of printable ASCII, checked 16 bytes at a time where we can.
+    std::size_t asciiRun(const char *data, std::size_t length);
+    // Byte length of the escape sequence starting at pos, which must be an ESC.
+    std::size_t escapeLength(std::string_view s, std::size_t pos);
+    // Decodes the UTF-8 sequence at pos and moves pos past it. Bad bytes come back as U+FFFD.
+    char32_t decodeUtf8(std::string_view s, std::size_t &pos);
+    int codepointWidth(char32_t c);
+
+    // Terminal columns the text takes up. ANSI escapes count for nothing, wide characters for two.
+    std::size_t displayWidth(std::string_view s);
+
+    // Word-wraps to width columns without breaking escape sequences or UTF-8 characters.
+    std::string wrap(std::string_view s, std::size_t width);
+    // Same as wrap(), but big texts are remembered per width so repeated sends skip the work.
+    std::shared_ptr<const std::string> wrapCached(const std::string &s, std::size_t width);
+
+}
+
+#endif //RINGNET_TEXT_H
@@ -0,0 +1,66 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_THROTTLE_H
+#define RINGNET_THROTTLE_H
+
+#include "sysdeps.h"
+#include <chrono>
+#include "nlohmann/json.hpp"
+
+namespace ring::net {
+
+    using throttle_clock = std::chrono::steady_clock;
+
+    // Rates are tokens per second, bursts are the bucket size. A rate of 0 disables that bucket.
+    struct throttle_config {
+        double line_rate = 0.0, line_burst = 0.0;
+        double byte_rate = 0.0, byte_burst = 0.0;
+    };
+
+    // A token bucket which is allowed to go into debt. Whatever was already read off the socket
+    // still gets charged, and the debt decides how long we stop reading for.
+    class token_bucket {
+    public:
+        void configure(double rate, double burst, throttle_clock::time_point now);
+        bool limited() const;
+        void refill(throttle_clock::time_point now);
+        void consume(double amount);
+        // Like consume(), but refuses rather than going into debt.
+        bool tryConsume(double amount);
+        bool exhausted() const;
+        bool full() const;
+        throttle_clock::duration waitTime() const;
+    protected:
+        double rate = 0.0, burst = 0.0, tokens = 0.0;
+        throttle_clock::time_point last;
+    };
+
+    // Written by the network threads, safe to read from the game thread.
+    struct throttle_stats {
+        std::atomic<uint64_t> bytes_in{0}, lines_in{0}, throttle_events{0}, lines_dropped{0};
+        std::atomic<uint64_t> throttled_ms{0};
+        nlohmann::json serialize() const;
+    };
+
+    class input_throttle {
+    public:
+        void configure(const throttle_config &cfg);
+        void countBytes(std::size_t amount);
+        void countLine();
+        // How long the reader should back off for. Zero means keep reading.
+        throttle_clock::duration delay();
+        // Returns true if this call moved us from flowing to throttled.
+        bool enterThrottle();
+        void leaveThrottle();
+        bool throttled = false;
+        throttle_stats stats;
+    protected:
+        token_bucket lines, bytes;
+        throttle_clock::time_point throttled_since;
+    };
+
+}
+
+#endif //RINGNET_THROTTLE_H
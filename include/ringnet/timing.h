@@ -0,0 +1,69 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_TIMING_H
+#define RINGNET_TIMING_H
+
+#include "sysdeps.h"
+#include <array>
+#include <chrono>
+#include "boost/asio.hpp"
+
+namespace ring::net {
+
+    using wheel_clock = std::chrono::steady_clock;
+
+    class timing_wheel;
+
+    // Zero disables idle timeouts and keepalives. The negotiation deadline is how long a new
+    // connection gets to answer the handshake before it's handed to the game anyway. A connection
+    // from behind a proxy that hasn't sent its PROXY header by proxy_header is dropped.
+    struct timeout_config {
+        std::chrono::seconds idle{0}, keepalive{0};
+        std::chrono::milliseconds negotiation{300}, proxy_header{5000};
+    };
+
+    // An intrusive timer entry. Arming and cancelling just links it into or out of a wheel slot.
+    struct wheel_timer {
+        std::function<void()> callback;
+        bool armed() const;
+    protected:
+        friend class timing_wheel;
+        uint64_t expires = 0;
+        wheel_timer *prev = nullptr, *next = nullptr, **slot = nullptr;
+        timing_wheel *wheel = nullptr;
+    };
+
+    // A hierarchical timing wheel: 4 levels of 64 slots. At the default 50ms tick that covers ~9 days,
+    // anything further out is clamped to the outermost slot and re-armed by whoever owns it.
+    class timing_wheel {
+    public:
+        explicit timing_wheel(boost::asio::io_context &con, std::chrono::milliseconds resolution = std::chrono::milliseconds(50));
+        void start();
+        void stop();
+        void arm(wheel_timer &t, wheel_clock::duration after);
+        void cancel(wheel_timer &t);
+        std::size_t size() const;
+    protected:
+        static constexpr int slot_bits = 6, slot_count = 1 << slot_bits, levels = 4;
+        static constexpr uint64_t slot_mask = slot_count - 1;
+        std::array<std::array<wheel_timer*, slot_count>, levels> slots{};
+        std::chrono::milliseconds resolution;
+        wheel_clock::time_point origin;
+        uint64_t current = 0;
+        std::size_t count = 0;
+        bool running = false;
+        mutable std::mutex wheel_mutex;
+        boost::asio::steady_timer ticker;
+        void schedule();
+        void tick();
+        void place(wheel_timer &t);
+        void unlink(wheel_timer &t);
+        void cascade(int level);
+        void advance(std::vector<wheel_timer*> &expired);
+    };
+
+}
+
+#endif //RINGNET_TIMING_H
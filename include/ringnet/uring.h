@@ -0,0 +1,93 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#ifndef RINGNET_URING_H
+#define RINGNET_URING_H
+
+#include "sysdeps.h"
+#include "boost/asio.hpp"
+
+namespace ring::net {
+
+    enum UringOp : uint8_t {
+        UringRecv = 0,
+        UringSend = 1,
+        UringAccept = 2,
+        UringCancel = 3
+    };
+
+    // Anything that wants io_uring completions. Completions are delivered one at a time from whichever
+    // executor thread is draining the ring, so a target never sees two of them at once. That thread isn't
+    // the target's strand: a target with state of its own should take what it needs from the completion
+    // and post the rest of the work there. data is only good until the call returns.
+    class uring_target {
+    public:
+        virtual ~uring_target() = default;
+        virtual void onUringRecv(int, const uint8_t *, std::size_t, bool) {}
+        virtual void onUringSend(int) {}
+        virtual void onUringAccept(int, bool) {}
+        uint64_t uring_id = 0;
+        std::atomic<bool> recv_armed{false}, accept_armed{false};
+    };
+
+    // An io_uring driven by the normal executor: the ring signals an eventfd, and asio waits on that.
+    // Reads are multishot into a ring of provided buffers, listeners use multishot accept, and sends
+    // are queued up and submitted together with one io_uring_enter per pass through the executor.
+    class uring_backend {
+    public:
+        // Checks the running kernel has everything we need: provided buffer rings, multishot accept and recv.
+        static bool supported();
+        uring_backend(boost::asio::io_context &con, unsigned entries = 4096, unsigned buffers = 512, unsigned buffer_size = 4096);
+        ~uring_backend();
+        bool ready() const;
+        void start();
+        void attach(uring_target &t);
+        void detach(uring_target &t);
+        // these are false if the submission queue stayed full, and nothing was queued.
+        bool recv(uring_target &t, int fd);
+        // the bytes are copied, or with shared, data points into it and it's held instead. either way they
+        // belong to the ring until the completion arrives, whatever has happened to the target by then.
+        bool send(uring_target &t, int fd, const void *data, std::size_t len,
+                  std::shared_ptr<const std::vector<uint8_t>> shared = nullptr);
+        bool accept(uring_target &t, int fd);
+        void cancel(uring_target &t, UringOp op);
+        void submit();
+    protected:
+        boost::asio::io_context &executor;
+        boost::asio::posix::stream_descriptor notify;
+        int ring_fd = -1, event_fd = -1;
+        bool is_ready = false, submit_posted = false;
+        unsigned entries = 0, buffer_count = 0, buffer_size = 0, pending = 0;
+        unsigned sq_tail_local = 0;
+        std::size_t sq_map_size = 0, cq_map_size = 0, sqe_map_size = 0, buf_ring_size = 0;
+        void *sq_map = nullptr, *cq_map = nullptr, *sqe_map = nullptr, *buf_ring_map = nullptr;
+        unsigned *sq_head = nullptr, *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+        unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+        void *sqes = nullptr, *cqes = nullptr;
+        std::vector<uint8_t> buffer_memory;
+        uint16_t buf_tail = 0;
+        std::mutex sq_mutex;
+        // held while a completion is dispatched, so detach() can't return while its target is being called.
+        std::recursive_mutex target_mutex;
+        uint64_t next_id = 1;
+        std::unordered_map<uint64_t, uring_target*> targets;
+        // a target's send in flight, or its last one so the copy buffer gets reused. under target_mutex.
+        struct send_op {
+            std::vector<uint8_t> bytes;
+            std::shared_ptr<const std::vector<uint8_t>> shared;
+            bool in_flight = false;
+        };
+        std::unordered_map<uint64_t, send_op> sends;
+        // null if the queue is still full after handing the kernel what it has a few times over.
+        void *nextSqe();
+        void pushSqe();
+        void recycle(uint16_t bid);
+        void wait();
+        void drain();
+        uring_target *find(uint64_t id);
+    };
+
+}
+
+#endif //RINGNET_URING_H
@@ -0,0 +1,94 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/admission.h"
+#include <string_view>
+
+namespace ring::net {
+
+    namespace {
+        // how many admissions go by between passes that forget idle addresses.
+        constexpr uint32_t sweep_interval = 1024;
+    }
+
+    nlohmann::json admission_stats::serialize() const {
+        nlohmann::json j = {
+                {"admitted", admitted.load()},
+                {"rejected_cap", rejected_cap.load()},
+                {"rejected_rate", rejected_rate.load()}
+        };
+        return j;
+    }
+
+    address_key addressKey(const boost::asio::ip::address &addr) {
+        if(addr.is_v4()) return boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, addr.to_v4()).to_bytes();
+        return addr.to_v6().to_bytes();
+    }
+
+    std::size_t address_key_hash::operator()(const address_key &k) const {
+        return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(k.data()), k.size()));
+    }
+
+    bool admission_control::admit(const boost::asio::ip::address &addr, const admission_config &cfg) {
+        auto now = throttle_clock::now();
+        std::lock_guard<std::mutex> guard(admission_mutex);
+        if(++admits_since_sweep >= sweep_interval) sweep(now);
+
+        auto found = addresses.find(addressKey(addr));
+        if(found == addresses.end()) {
+            found = addresses.emplace(addressKey(addr), ip_state()).first;
+            // a burst under one would never let anybody in.
+            found->second.rate.configure(cfg.connect_rate, std::max(cfg.connect_burst, 1.0), now);
+        }
+        auto &state = found->second;
+        if(cfg.max_per_ip && state.open >= cfg.max_per_ip) {
+            stats.rejected_cap++;
+            return false;
+        }
+        state.rate.refill(now);
+        if(!state.rate.tryConsume(1.0)) {
+            stats.rejected_rate++;
+            return false;
+        }
+        state.open++;
+        stats.admitted++;
+        return true;
+    }
+
+    void admission_control::track(const boost::asio::ip::address &addr) {
+        std::lock_guard<std::mutex> guard(admission_mutex);
+        addresses[addressKey(addr)].open++;
+    }
+
+    void admission_control::release(const boost::asio::ip::address &addr) {
+        std::lock_guard<std::mutex> guard(admission_mutex);
+        auto found = addresses.find(addressKey(addr));
+        if(found == addresses.end()) return;
+        auto &state = found->second;
+        if(state.open) state.open--;
+        state.rate.refill(throttle_clock::now());
+        // an address still earning back its rate allowance has to be remembered, or reconnecting would reset it.
+        if(!state.open && state.rate.full()) addresses.erase(found);
+    }
+
+    std::size_t admission_control::tracked() {
+        std::lock_guard<std::mutex> guard(admission_mutex);
+        return addresses.size();
+    }
+
+    void admission_control::sweep(throttle_clock::time_point now) {
+        admits_since_sweep = 0;
+        for(auto it = addresses.begin(); it != addresses.end();) {
+            if(!it->second.open) {
+                it->second.rate.refill(now);
+                if(it->second.rate.full()) {
+                    it = addresses.erase(it);
+                    continue;
+                }
+            }
+            it++;
+        }
+    }
+
+}
@@ -0,0 +1,116 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/affinity.h"
+#include "ringnet/handler_alloc.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <sched.h>
+
+namespace ring::net {
+
+    std::vector<int> parseCpuList(const std::string &list) {
+        std::vector<int> out;
+        std::size_t pos = 0;
+        while(pos < list.size()) {
+            auto end = list.find(',', pos);
+            if(end == std::string::npos) end = list.size();
+            auto part = list.substr(pos, end - pos);
+            pos = end + 1;
+            int first, last;
+            char dash;
+            std::istringstream in(part);
+            if(!(in >> first) || first < 0) continue;
+            last = first;
+            if(in >> dash && (dash != '-' || !(in >> last) || last < first)) continue;
+            for(int c = first; c <= last; c++) out.push_back(c);
+        }
+        return out;
+    }
+
+    std::vector<int> allowedCpus() {
+        // sched_getaffinity only knows the calling thread's mask, which stops meaning the process's once
+        // anything is pinned. pinThread() asks first, so this is taken before that.
+        static const std::vector<int> process = [] {
+            std::vector<int> out;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(sched_getaffinity(0, sizeof(set), &set)) return out;
+            for(int c = 0; c < CPU_SETSIZE; c++) {
+                if(CPU_ISSET(c, &set)) out.push_back(c);
+            }
+            return out;
+        }();
+        return process;
+    }
+
+    int numaNodeOf(int cpu) {
+        // each node's directory lists the CPUs on it. single-node and non-NUMA kernels may not have any.
+        for(int node = 0; node < 64; node++) {
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if(!f) {
+                if(node) return -1;
+                continue;
+            }
+            std::string list;
+            std::getline(f, list);
+            auto cpus = parseCpuList(list);
+            if(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end()) return node;
+        }
+        return -1;
+    }
+
+    bool pinThread(const std::vector<int> &cpus) {
+        allowedCpus();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        bool any = false;
+        for(auto c : cpus) {
+            if(c < 0 || c >= CPU_SETSIZE) continue;
+            CPU_SET(c, &set);
+            any = true;
+        }
+        return any && !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    void thread_placement::configure(const affinity_config &cfg) {
+        config = cfg;
+        shared.clear();
+        if(config.game_cpu < 0) return;
+        std::erase(config.cpus, config.game_cpu);
+        for(auto c : allowedCpus()) {
+            if(c != config.game_cpu) shared.push_back(c);
+        }
+    }
+
+    std::vector<int> thread_placement::cpusFor(std::size_t index) const {
+        if(!config.cpus.empty()) return {config.cpus[index % config.cpus.size()]};
+        return shared;
+    }
+
+    void thread_placement::enter(std::size_t index) {
+        auto cpus = cpusFor(index);
+        if(cpus.empty()) return;
+        if(!pinThread(cpus)) {
+            std::cerr << "Could not pin executor thread " << index << ", leaving it to the scheduler." << std::endl;
+            return;
+        }
+        // linux places pages on the node of the thread that first touches them, so this has to come after pinning.
+        if(config.numa_local) handler_memory::warm();
+        auto cpu = sched_getcpu();
+        std::lock_guard<std::mutex> guard(placed_mutex);
+        placed[index] = {cpu, numaNodeOf(cpu)};
+    }
+
+    nlohmann::json thread_placement::serialize() {
+        auto threads = nlohmann::json::array();
+        std::lock_guard<std::mutex> guard(placed_mutex);
+        for(auto &p : placed) {
+            threads.push_back({{"thread", p.first}, {"cpu", p.second.first}, {"node", p.second.second}});
+        }
+        return {{"game_cpu", config.game_cpu}, {"threads", threads}};
+    }
+
+}
@@ -0,0 +1,110 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/asset.h"
+#include "ringnet/color.h"
+#include "ringnet/telnet.h"
+#include <fstream>
+#include <sstream>
+
+namespace ring::net {
+
+    nlohmann::json asset_stats::serialize() const {
+        return {
+                {"loads", loads.load()},
+                {"reloads", reloads.load()},
+                {"hits", hits.load()},
+                {"failures", failures.load()}
+        };
+    }
+
+    std::shared_ptr<const static_asset> asset_cache::get(const std::string &path) {
+        auto now = std::chrono::steady_clock::now();
+        std::shared_ptr<const static_asset> cached;
+        {
+            std::lock_guard<std::mutex> guard(cache_mutex);
+            auto found = assets.find(path);
+            if(found != assets.end()) {
+                if(now - found->second.checked < recheck) {
+                    stats.hits++;
+                    return found->second.asset;
+                }
+                found->second.checked = now;
+                cached = found->second.asset;
+            }
+        }
+
+        std::error_code ec;
+        auto mtime = fs::last_write_time(path, ec);
+        if(ec) {
+            // gone or unreadable. keep serving what we had rather than send nothing.
+            if(cached) return cached;
+            stats.failures++;
+            return nullptr;
+        }
+        if(cached && cached->mtime == mtime) {
+            stats.hits++;
+            return cached;
+        }
+
+        // built outside the lock: rendering a big file shouldn't hold up sends of everything else.
+        auto built = load(path, mtime);
+        if(!built) {
+            stats.failures++;
+            return cached;
+        }
+        if(cached) stats.reloads++;
+        else stats.loads++;
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        assets[path] = {built, now};
+        return built;
+    }
+
+    std::shared_ptr<const static_asset> asset_cache::load(const std::string &path, fs::file_time_type mtime) {
+        std::ifstream f(path, std::ios::binary);
+        if(!f) return nullptr;
+        std::ostringstream contents;
+        contents << f.rdbuf();
+
+        auto asset = std::make_shared<static_asset>();
+        asset->path = path;
+        asset->mtime = mtime;
+        asset->source = contents.str();
+        color::Markup markup(asset->source);
+        for(uint8_t tier = NoColor; tier <= TrueColor; tier++) {
+            asset->wire[tier] = std::make_shared<const std::vector<uint8_t>>(
+                    telnet::frameText(markup.render(static_cast<ColorType>(tier)), Text, false));
+        }
+        return asset;
+    }
+
+    void asset_cache::forget(const std::string &path) {
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        assets.erase(path);
+    }
+
+    void asset_cache::clear() {
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        assets.clear();
+    }
+
+    std::size_t asset_cache::bytes() {
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        std::size_t total = 0;
+        for(auto &a : assets) {
+            total += stringHeap(a.second.asset->path) + stringHeap(a.second.asset->source);
+            for(auto &w : a.second.asset->wire) total += w->capacity();
+        }
+        return total;
+    }
+
+    nlohmann::json asset_cache::serialize() {
+        auto j = stats.serialize();
+        j["bytes"] = bytes();
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        j["cached"] = assets.size();
+        return j;
+    }
+
+}
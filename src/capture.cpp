@@ -0,0 +1,155 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/capture.h"
+#include <cstring>
+
+namespace ring::net {
+
+    namespace {
+        // a write bigger than this goes down as several records, so one never takes up much of a ring.
+        constexpr std::size_t max_payload = 16384;
+        constexpr auto flush_interval = std::chrono::milliseconds(20);
+    }
+
+    nlohmann::json capture_stats::serialize() const {
+        nlohmann::json j = {
+                {"records", records.load()},
+                {"bytes", bytes.load()},
+                {"dropped", dropped.load()}
+        };
+        return j;
+    }
+
+    capture_ring::capture_ring(std::size_t capacity) : ring(capacity), mask(capacity - 1) {}
+
+    void capture_ring::put(uint64_t pos, const void *src, std::size_t len) {
+        auto offset = pos & mask;
+        auto first = std::min(len, ring.size() - offset);
+        memcpy(ring.data() + offset, src, first);
+        memcpy(ring.data(), static_cast<const uint8_t*>(src) + first, len - first);
+    }
+
+    bool capture_ring::write(const capture_record &rec, const uint8_t *data, std::size_t len) {
+        auto need = sizeof(rec) + len;
+        auto t = tail.load(std::memory_order_relaxed);
+        if(ring.size() - (t - head.load(std::memory_order_acquire)) < need) return false;
+        put(t, &rec, sizeof(rec));
+        put(t + sizeof(rec), data, len);
+        tail.store(t + need, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t capture_ring::drain(FILE *out) {
+        auto h = head.load(std::memory_order_relaxed);
+        auto t = tail.load(std::memory_order_acquire);
+        if(h == t) return 0;
+        // whole records only ever become visible, so the bytes can go to the file as they are.
+        auto offset = h & mask;
+        auto total = t - h;
+        auto first = std::min<std::size_t>(total, ring.size() - offset);
+        fwrite(ring.data() + offset, 1, first, out);
+        if(total > first) fwrite(ring.data(), 1, total - first, out);
+        head.store(t, std::memory_order_release);
+        return total;
+    }
+
+    void capture_ring::reset() {
+        head.store(0);
+        tail.store(0);
+    }
+
+    io_capture::~io_capture() {
+        close();
+    }
+
+    bool io_capture::open(const std::string &path, std::size_t bytes) {
+        if(enabled) return true;
+        if(!bytes || (bytes & (bytes - 1))) {
+            std::cerr << "Capture ring size must be a power of two: " << bytes << std::endl;
+            return false;
+        }
+        file = fopen(path.c_str(), "wb");
+        if(!file) {
+            std::cerr << "Failed to open capture file " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        capture_file_header header{};
+        memcpy(header.magic, "RNCAP\0\0\0", 8);
+        header.version = capture_version;
+        header.started = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        fwrite(&header, sizeof(header), 1, file);
+
+        {
+            std::lock_guard<std::mutex> guard(ring_mutex);
+            // rings stay with their threads from one capture to the next, so a new size only
+            // applies to threads that haven't recorded anything yet.
+            for(auto &r : rings) r->reset();
+            ring_bytes = bytes;
+        }
+        started = std::chrono::steady_clock::now();
+        enabled = true;
+        flusher = std::thread([this] {
+            while(enabled) {
+                std::this_thread::sleep_for(flush_interval);
+                flush();
+            }
+        });
+        return true;
+    }
+
+    void io_capture::close() {
+        if(!enabled.exchange(false)) return;
+        if(flusher.joinable()) flusher.join();
+        flush();
+        fclose(file);
+        file = nullptr;
+    }
+
+    bool io_capture::active() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    uint32_t io_capture::nextConnection() {
+        return ++connections;
+    }
+
+    capture_ring *io_capture::local() {
+        thread_local io_capture *owner = nullptr;
+        thread_local capture_ring *mine = nullptr;
+        if(owner != this || !mine) {
+            std::lock_guard<std::mutex> guard(ring_mutex);
+            rings.push_back(std::make_unique<capture_ring>(ring_bytes));
+            mine = rings.back().get();
+            owner = this;
+        }
+        return mine;
+    }
+
+    void io_capture::record(uint32_t conn, CaptureKind kind, const uint8_t *data, std::size_t len) {
+        if(!active()) return;
+        auto ring = local();
+        auto when = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+        do {
+            auto chunk = std::min(len, max_payload);
+            capture_record rec{static_cast<uint64_t>(when), conn, static_cast<uint32_t>(chunk << 8 | kind)};
+            if(ring->write(rec, data, chunk)) {
+                stats.records++;
+                stats.bytes += chunk;
+            } else {
+                stats.dropped++;
+            }
+            data += chunk;
+            len -= chunk;
+        } while(len);
+    }
+
+    void io_capture::flush() {
+        std::lock_guard<std::mutex> guard(ring_mutex);
+        if(!file) return;
+        for(auto &r : rings) r->drain(file);
+        fflush(file);
+    }
+
+}
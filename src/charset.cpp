@@ -0,0 +1,296 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/charset.h"
+#include "ringnet/text.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <tmmintrin.h>
+#define RINGNET_SSSE3_UTF8 1
+#endif
+
+namespace ring::text {
+
+    namespace {
+
+        // the top half of code page 437. the bottom half is ASCII as far as telnet is concerned.
+        constexpr char16_t cp437_high[128] = {
+                0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+                0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+                0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+                0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+                0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+                0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+                0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+                0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+        };
+
+        // each legacy byte, already encoded as UTF-8.
+        struct utf8_char {
+            uint8_t length;
+            char bytes[3];
+        };
+
+        constexpr utf8_char encodeChar(char32_t c) {
+            if(c < 0x80) return {1, {static_cast<char>(c), 0, 0}};
+            if(c < 0x800) return {2, {static_cast<char>(0xC0 | (c >> 6)), static_cast<char>(0x80 | (c & 0x3F)), 0}};
+            return {3, {static_cast<char>(0xE0 | (c >> 12)), static_cast<char>(0x80 | ((c >> 6) & 0x3F)),
+                        static_cast<char>(0x80 | (c & 0x3F))}};
+        }
+
+        constexpr std::array<utf8_char, 256> latin1_table = [] {
+            std::array<utf8_char, 256> t{};
+            for(int i = 0; i < 256; i++) t[i] = encodeChar(i);
+            return t;
+        }();
+
+        constexpr std::array<utf8_char, 256> cp437_table = [] {
+            std::array<utf8_char, 256> t{};
+            for(int i = 0; i < 128; i++) t[i] = encodeChar(i);
+            for(int i = 0; i < 128; i++) t[128 + i] = encodeChar(cp437_high[i]);
+            return t;
+        }();
+
+        // unicode -> cp437 byte, sorted for binary search.
+        const std::array<std::pair<char32_t, uint8_t>, 128> &cp437Reverse() {
+            static const auto table = [] {
+                std::array<std::pair<char32_t, uint8_t>, 128> t{};
+                for(int i = 0; i < 128; i++) t[i] = {cp437_high[i], static_cast<uint8_t>(128 + i)};
+                std::sort(t.begin(), t.end());
+                return t;
+            }();
+            return table;
+        }
+
+        void appendReplacement(std::string &out) {
+            out.append("\xEF\xBF\xBD");
+        }
+
+        // length of the valid sequence at pos, or 0 if it isn't one.
+        std::size_t validSequence(const uint8_t *s, std::size_t left) {
+            auto c = s[0];
+            if(c < 0x80) return 1;
+            if(c < 0xC2) return 0;
+            if(c < 0xE0) {
+                return left >= 2 && (s[1] & 0xC0) == 0x80 ? 2 : 0;
+            }
+            if(c < 0xF0) {
+                if(left < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80) return 0;
+                if(c == 0xE0 && s[1] < 0xA0) return 0; // overlong
+                if(c == 0xED && s[1] >= 0xA0) return 0; // surrogate
+                return 3;
+            }
+            if(c < 0xF5) {
+                if(left < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 || (s[3] & 0xC0) != 0x80) return 0;
+                if(c == 0xF0 && s[1] < 0x90) return 0; // overlong
+                if(c == 0xF4 && s[1] >= 0x90) return 0; // past U+10FFFF
+                return 4;
+            }
+            return 0;
+        }
+
+        bool validScalar(const uint8_t *s, std::size_t length) {
+            std::size_t i = 0;
+            while(i < length) {
+                i += asciiPrefix(reinterpret_cast<const char*>(s + i), length - i);
+                if(i >= length) break;
+                auto len = validSequence(s + i, length - i);
+                if(!len) return false;
+                i += len;
+            }
+            return true;
+        }
+
+#ifdef RINGNET_SSSE3_UTF8
+        // The lookup algorithm from Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+        // Three nibble lookups classify every pair of adjacent bytes, and a saturating subtract finds
+        // where a third or fourth continuation byte has to be.
+        constexpr uint8_t TOO_SHORT = 1 << 0, TOO_LONG = 1 << 1, OVERLONG_3 = 1 << 2, TOO_LARGE = 1 << 3;
+        constexpr uint8_t SURROGATE = 1 << 4, OVERLONG_2 = 1 << 5, TOO_LARGE_1000 = 1 << 6, OVERLONG_4 = 1 << 6;
+        constexpr uint8_t TWO_CONTS = 1 << 7;
+        constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+        __attribute__((target("ssse3")))
+        inline __m128i lookup16(__m128i table, __m128i idx) {
+            return _mm_shuffle_epi8(table, idx);
+        }
+
+        __attribute__((target("ssse3")))
+        inline __m128i highNibbles(__m128i v) {
+            return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+        }
+
+        __attribute__((target("ssse3")))
+        __m128i checkBlock(__m128i input, __m128i prev_input) {
+            const __m128i byte_1_high_table = _mm_setr_epi8(
+                    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+                    TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+                    TOO_SHORT | OVERLONG_2,
+                    TOO_SHORT,
+                    TOO_SHORT | OVERLONG_3 | SURROGATE,
+                    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+            const __m128i byte_1_low_table = _mm_setr_epi8(
+                    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+                    CARRY | OVERLONG_2,
+                    CARRY,
+                    CARRY,
+                    CARRY | TOO_LARGE,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000,
+                    CARRY | TOO_LARGE | TOO_LARGE_1000);
+            const __m128i byte_2_high_table = _mm_setr_epi8(
+                    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                    TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+                    TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+            auto prev1 = _mm_alignr_epi8(input, prev_input, 15);
+            auto special = _mm_and_si128(
+                    _mm_and_si128(lookup16(byte_1_high_table, highNibbles(prev1)),
+                                  lookup16(byte_1_low_table, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)))),
+                    lookup16(byte_2_high_table, highNibbles(input)));
+
+            auto prev2 = _mm_alignr_epi8(input, prev_input, 14);
+            auto prev3 = _mm_alignr_epi8(input, prev_input, 13);
+            auto third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+            auto fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+            auto must_be_cont = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+            return _mm_xor_si128(must_be_cont, special);
+        }
+
+        __attribute__((target("ssse3")))
+        bool validSsse3(const uint8_t *s, std::size_t length) {
+            __m128i error = _mm_setzero_si128(), prev = _mm_setzero_si128();
+            bool prev_ascii = true;
+            std::size_t i = 0;
+            for(; i + 16 <= length; i += 16) {
+                auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+                bool ascii = !_mm_movemask_epi8(input);
+                if(!(ascii && prev_ascii)) error = _mm_or_si128(error, checkBlock(input, prev));
+                prev = input;
+                prev_ascii = ascii;
+            }
+            // zero padding is ASCII, so a sequence cut off by the end of the text shows up as TOO_SHORT.
+            uint8_t tail[16] = {0};
+            std::memcpy(tail, s + i, length - i);
+            auto input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+            error = _mm_or_si128(error, checkBlock(input, prev));
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+        }
+
+        bool haveSsse3() {
+            static const bool supported = __builtin_cpu_supports("ssse3");
+            return supported;
+        }
+#endif
+
+        std::string toUtf8(std::string_view s, const std::array<utf8_char, 256> &table) {
+            std::string out;
+            out.reserve(s.size() + s.size() / 4);
+            std::size_t i = 0;
+            while(i < s.size()) {
+                auto run = asciiPrefix(s.data() + i, s.size() - i);
+                out.append(s.substr(i, run));
+                i += run;
+                for(; i < s.size() && static_cast<uint8_t>(s[i]) >= 0x80; i++) {
+                    auto &c = table[static_cast<uint8_t>(s[i])];
+                    out.append(c.bytes, c.length);
+                }
+            }
+            return out;
+        }
+    }
+
+    std::size_t asciiPrefix(const char *data, std::size_t length) {
+        std::size_t i = 0;
+#if defined(__SSE2__)
+        for(; i + 16 <= length; i += 16) {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+            if(mask) return i + __builtin_ctz(mask);
+        }
+#endif
+        for(; i < length; i++) {
+            if(static_cast<uint8_t>(data[i]) >= 0x80) return i;
+        }
+        return length;
+    }
+
+    bool validUtf8(std::string_view s) {
+        auto data = reinterpret_cast<const uint8_t*>(s.data());
+#ifdef RINGNET_SSSE3_UTF8
+        if(haveSsse3()) return validSsse3(data, s.size());
+#endif
+        return validScalar(data, s.size());
+    }
+
+    std::string sanitizeUtf8(std::string_view s) {
+        if(validUtf8(s)) return std::string(s);
+        auto data = reinterpret_cast<const uint8_t*>(s.data());
+        std::string out;
+        out.reserve(s.size() + 8);
+        std::size_t i = 0;
+        while(i < s.size()) {
+            auto len = validSequence(data + i, s.size() - i);
+            if(len) {
+                out.append(s.substr(i, len));
+                i += len;
+            } else {
+                appendReplacement(out);
+                i++;
+            }
+        }
+        return out;
+    }
+
+    std::string toUtf8(std::string_view s, net::CharsetType from) {
+        switch(from) {
+            case net::Latin1:
+                return toUtf8(s, latin1_table);
+            case net::Cp437:
+                return toUtf8(s, cp437_table);
+            default:
+                return sanitizeUtf8(s);
+        }
+    }
+
+    std::string fromUtf8(std::string_view s, net::CharsetType to) {
+        if(to == net::Utf8) return std::string(s);
+        std::string out;
+        out.reserve(s.size());
+        std::size_t i = 0;
+        while(i < s.size()) {
+            auto run = asciiPrefix(s.data() + i, s.size() - i);
+            out.append(s.substr(i, run));
+            i += run;
+            if(i >= s.size()) break;
+            auto c = decodeUtf8(s, i);
+            if(to == net::Latin1) {
+                out.push_back(c < 0x100 ? static_cast<char>(c) : '?');
+                continue;
+            }
+            auto &table = cp437Reverse();
+            auto found = std::lower_bound(table.begin(), table.end(), std::make_pair(c, uint8_t(0)));
+            out.push_back(found != table.end() && found->first == c ? static_cast<char>(found->second) : '?');
+        }
+        return out;
+    }
+
+}
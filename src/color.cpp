@@ -0,0 +1,366 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/color.h"
+
+namespace ring::color {
+
+    namespace {
+
+        struct rgb {
+            uint8_t r, g, b;
+        };
+
+        constexpr uint8_t cube_levels[6] = {0, 95, 135, 175, 215, 255};
+
+        constexpr std::array<rgb, 256> xterm_palette = [] {
+            std::array<rgb, 256> p{};
+            constexpr rgb base[16] = {
+                    {0, 0, 0}, {128, 0, 0}, {0, 128, 0}, {128, 128, 0},
+                    {0, 0, 128}, {128, 0, 128}, {0, 128, 128}, {192, 192, 192},
+                    {128, 128, 128}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+                    {0, 0, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255}
+            };
+            for(int i = 0; i < 16; i++) p[i] = base[i];
+            for(int i = 0; i < 216; i++) {
+                p[16 + i] = {cube_levels[i / 36], cube_levels[(i / 6) % 6], cube_levels[i % 6]};
+            }
+            for(int i = 0; i < 24; i++) {
+                uint8_t v = 8 + 10 * i;
+                p[232 + i] = {v, v, v};
+            }
+            return p;
+        }();
+
+        constexpr int distance(const rgb &a, const rgb &b) {
+            int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+            return dr * dr + dg * dg + db * db;
+        }
+
+        // channel value -> nearest cube level.
+        constexpr std::array<uint8_t, 256> cube_index = [] {
+            std::array<uint8_t, 256> t{};
+            for(int v = 0; v < 256; v++) {
+                int best = 0;
+                for(int i = 1; i < 6; i++) {
+                    auto d = v - cube_levels[i], bd = v - cube_levels[best];
+                    if(d * d < bd * bd) best = i;
+                }
+                t[v] = best;
+            }
+            return t;
+        }();
+
+        // gray value -> nearest entry on the 232-255 ramp.
+        constexpr std::array<uint8_t, 256> gray_index = [] {
+            std::array<uint8_t, 256> t{};
+            for(int v = 0; v < 256; v++) {
+                int i = (v - 3) / 10;
+                t[v] = 232 + std::min(std::max(i, 0), 23);
+            }
+            return t;
+        }();
+
+        constexpr std::array<uint8_t, 256> ansi_index = [] {
+            std::array<uint8_t, 256> t{};
+            for(int i = 0; i < 256; i++) {
+                if(i < 16) {
+                    t[i] = i;
+                    continue;
+                }
+                int best = 0;
+                for(int j = 1; j < 16; j++) {
+                    if(distance(xterm_palette[i], xterm_palette[j]) < distance(xterm_palette[i], xterm_palette[best])) best = j;
+                }
+                t[i] = best;
+            }
+            return t;
+        }();
+
+        constexpr color_code makeColor(ColorKind kind, uint32_t value) {
+            return (uint32_t(kind) << 24) | (value & 0xFFFFFF);
+        }
+
+        constexpr ColorKind kindOf(color_code c) {
+            return ColorKind(c >> 24);
+        }
+
+        int ansiLetter(char c) {
+            switch(c) {
+                case 'x': return 0;
+                case 'r': return 1;
+                case 'g': return 2;
+                case 'y': return 3;
+                case 'b': return 4;
+                case 'm': return 5;
+                case 'c': return 6;
+                case 'w': return 7;
+                case 'X': return 8;
+                case 'R': return 9;
+                case 'G': return 10;
+                case 'Y': return 11;
+                case 'B': return 12;
+                case 'M': return 13;
+                case 'C': return 14;
+                case 'W': return 15;
+                default: return -1;
+            }
+        }
+
+        int hexDigit(char c) {
+            if(c >= '0' && c <= '9') return c - '0';
+            if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        // parses a color starting at pos. returns how many characters it used, or 0.
+        std::size_t parseColor(std::string_view src, std::size_t pos, color_code &out) {
+            auto left = src.size() - pos;
+            if(!left) return 0;
+            auto c = src[pos];
+
+            auto a = ansiLetter(c);
+            if(a >= 0) {
+                out = makeColor(Ansi16, a);
+                return 1;
+            }
+
+            if(c >= '0' && c <= '5' && left >= 3) {
+                auto g = src[pos + 1], b = src[pos + 2];
+                if(g >= '0' && g <= '5' && b >= '0' && b <= '5') {
+                    out = makeColor(Xterm256, 16 + 36 * (c - '0') + 6 * (g - '0') + (b - '0'));
+                    return 3;
+                }
+                return 0;
+            }
+
+            if(c == '=' && left >= 2) {
+                auto g = src[pos + 1];
+                if(g < 'a' || g > 'z') return 0;
+                if(g == 'a') out = makeColor(Xterm256, 16);
+                else if(g == 'z') out = makeColor(Xterm256, 231);
+                else out = makeColor(Xterm256, 232 + (g - 'b'));
+                return 2;
+            }
+
+            if(c == '#' && left >= 7) {
+                uint32_t value = 0;
+                for(int i = 1; i <= 6; i++) {
+                    auto h = hexDigit(src[pos + i]);
+                    if(h < 0) return 0;
+                    value = (value << 4) | h;
+                }
+                out = makeColor(Rgb, value);
+                return 7;
+            }
+            return 0;
+        }
+
+        void appendNumber(std::string &out, unsigned int n) {
+            char buf[4];
+            int len = 0;
+            do {
+                buf[len++] = '0' + (n % 10);
+                n /= 10;
+            } while(n);
+            while(len) out.push_back(buf[--len]);
+        }
+
+        void appendColor(std::string &out, color_code c, bool background, net::ColorType tier) {
+            auto kind = kindOf(c);
+            if(kind == NoKind) return;
+            uint32_t value = c & 0xFFFFFF;
+
+            if(kind == Rgb && tier == net::TrueColor) {
+                out.append(background ? ";48;2;" : ";38;2;");
+                appendNumber(out, value >> 16);
+                out.push_back(';');
+                appendNumber(out, (value >> 8) & 0xFF);
+                out.push_back(';');
+                appendNumber(out, value & 0xFF);
+                return;
+            }
+            if(kind == Rgb) {
+                value = rgbToXterm(value >> 16, (value >> 8) & 0xFF, value & 0xFF);
+                kind = Xterm256;
+            }
+            if(kind == Xterm256 && tier >= net::XtermColor) {
+                out.append(background ? ";48;5;" : ";38;5;");
+                appendNumber(out, value);
+                return;
+            }
+            if(kind == Xterm256) value = xtermToAnsi(value);
+
+            // what's left is one of the 16 basic colors.
+            if(value < 8) {
+                out.append(background ? ";4" : ";3");
+                out.push_back('0' + value);
+            } else if(tier >= net::XtermColor) {
+                out.append(background ? ";10" : ";9");
+                out.push_back('0' + (value - 8));
+            } else if(background) {
+                // no such thing as a bright background on plain ANSI.
+                out.append(";4");
+                out.push_back('0' + (value - 8));
+            } else {
+                out.append(";1;3");
+                out.push_back('0' + (value - 8));
+            }
+        }
+
+        void appendStyle(std::string &out, const style &st, net::ColorType tier) {
+            out.append("\x1b[0");
+            if(st.attrs & Bold) out.append(";1");
+            if(st.attrs & Italic) out.append(";3");
+            if(st.attrs & Underline) out.append(";4");
+            if(st.attrs & Inverse) out.append(";7");
+            appendColor(out, st.fg, false, tier);
+            appendColor(out, st.bg, true, tier);
+            out.push_back('m');
+        }
+    }
+
+    uint8_t rgbToXterm(uint8_t r, uint8_t g, uint8_t b) {
+        rgb want{r, g, b};
+        uint8_t cube = 16 + 36 * cube_index[r] + 6 * cube_index[g] + cube_index[b];
+        uint8_t gray = gray_index[(r + g + b) / 3];
+        return distance(want, xterm_palette[gray]) < distance(want, xterm_palette[cube]) ? gray : cube;
+    }
+
+    uint8_t xtermToAnsi(uint8_t index) {
+        return ansi_index[index];
+    }
+
+    bool style::operator==(const style &other) const {
+        return fg == other.fg && bg == other.bg && attrs == other.attrs;
+    }
+
+    bool style::operator!=(const style &other) const {
+        return !(*this == other);
+    }
+
+    bool style::plain() const {
+        return !fg && !bg && !attrs;
+    }
+
+    Markup::Markup(std::string_view src) {
+        text.reserve(src.size());
+        style current;
+        std::size_t i = 0;
+        while(i < src.size()) {
+            auto pipe = src.find('|', i);
+            if(pipe == std::string_view::npos) pipe = src.size();
+            text.append(src.substr(i, pipe - i));
+            if(pipe >= src.size()) break;
+
+            if(pipe + 1 < src.size() && src[pipe + 1] == '|') {
+                text.push_back('|');
+                i = pipe + 2;
+                continue;
+            }
+            auto used = parseCode(src, pipe + 1, current);
+            if(used) {
+                setStyle(current);
+            } else {
+                text.push_back('|');
+            }
+            i = pipe + 1 + used;
+        }
+    }
+
+    std::size_t Markup::parseCode(std::string_view src, std::size_t pos, style &st) {
+        if(pos >= src.size()) return 0;
+        switch(src[pos]) {
+            case 'n':
+                st = style();
+                return 1;
+            case 'h':
+                st.attrs |= Bold;
+                return 1;
+            case 'H':
+                st.attrs &= ~Bold;
+                return 1;
+            case 'u':
+                st.attrs |= Underline;
+                return 1;
+            case 'U':
+                st.attrs &= ~Underline;
+                return 1;
+            case 'i':
+                st.attrs |= Italic;
+                return 1;
+            case 'I':
+                st.attrs &= ~Italic;
+                return 1;
+            case '*':
+                st.attrs |= Inverse;
+                return 1;
+            case '[': {
+                auto used = parseColor(src, pos + 1, st.bg);
+                return used ? used + 1 : 0;
+            }
+            default:
+                return parseColor(src, pos, st.fg);
+        }
+    }
+
+    void Markup::setStyle(const style &st) {
+        if(!spans.empty() && spans.back().start == text.size()) {
+            // nothing was written under the last style, so just replace it.
+            spans.back().st = st;
+            if(spans.size() > 1 ? spans[spans.size() - 2].st == st : st.plain()) spans.pop_back();
+            return;
+        }
+        style last = spans.empty() ? style() : spans.back().st;
+        if(last != st) spans.push_back({static_cast<uint32_t>(text.size()), st});
+    }
+
+    const std::string& Markup::plain() const {
+        return text;
+    }
+
+    const std::string& Markup::render(net::ColorType tier) const {
+        if(tier == net::NoColor || spans.empty()) return text;
+        std::call_once(rendered_once[tier], [&] { rendered[tier] = renderTier(tier); });
+        return rendered[tier];
+    }
+
+    std::string Markup::renderTier(net::ColorType tier) const {
+        std::string out;
+        out.reserve(text.size() + spans.size() * 16);
+        style active;
+        std::size_t pos = 0;
+        for(const auto &s : spans) {
+            out.append(text, pos, s.start - pos);
+            pos = s.start;
+            if(s.st != active) {
+                appendStyle(out, s.st, tier);
+                active = s.st;
+            }
+        }
+        out.append(text, pos, std::string::npos);
+        if(!active.plain()) out.append("\x1b[0m");
+        return out;
+    }
+
+    std::string render(std::string_view src, net::ColorType tier) {
+        return Markup(src).render(tier);
+    }
+
+    std::string strip(std::string_view src) {
+        return Markup(src).plain();
+    }
+
+    std::string escape(std::string_view src) {
+        std::string out;
+        out.reserve(src.size());
+        for(auto c : src) {
+            if(c == '|') out.push_back('|');
+            out.push_back(c);
+        }
+        return out;
+    }
+
+}
@@ -3,9 +3,16 @@
 //
 
 #include "ringnet/connection.h"
+#include "ringnet/color.h"
+#include "ringnet/asset.h"
 
 namespace ring::net {
 
+    std::size_t stringHeap(const std::string &s) {
+        // anything that fits in the small string buffer costs nothing extra.
+        return s.capacity() > std::string().capacity() ? s.capacity() + 1 : 0;
+    }
+
     MudConnection::MudConnection(std::string &conn_id, boost::asio::io_context &con) : conn_strand(con), conn_id(conn_id),
     game_messages(128) {}
 
@@ -21,6 +28,121 @@ namespace ring::net {
         sendText(txt, Prompt);
     }
 
+    void MudConnection::sendMarkup(const color::Markup &m, TextType mode) {
+        if(mode == Line) sendLine(m.render(details.renderColor()));
+        else sendText(m.render(details.renderColor()), mode);
+    }
+
+    void MudConnection::sendAsset(const std::shared_ptr<const static_asset> &asset) {
+        if(asset) sendText(color::render(asset->source, details.renderColor()), Text);
+    }
+
+    nlohmann::json GameMsg::gmcpData() const {
+        if(gmcp_raw.empty()) return nullptr;
+        auto j = nlohmann::json::parse(gmcp_raw, nullptr, false);
+        return j.is_discarded() ? nlohmann::json() : j;
+    }
+
+    bool MudConnection::takeInput(GameMsg &g) {
+        if(!game_messages.pop(g)) return false;
+        auto now = latency_clock::now();
+        latency.record(LatencyQueue, now - g.queued);
+        // lines that arrive while one is still waiting on its answer are only timed this far.
+        // and GMCP isn't a command anyone waits on an answer to.
+        if(g.gmcp.empty()) dropUnanswered();
+        if(g.gmcp.empty() && !trace_taken.load(std::memory_order_relaxed)) {
+            trace_read.store(g.received.time_since_epoch().count(), std::memory_order_relaxed);
+            trace_taken.store(now.time_since_epoch().count(), std::memory_order_release);
+        }
+        return true;
+    }
+
+    void MudConnection::dropUnanswered() {
+        if(trace_answered.load(std::memory_order_acquire)) return;
+        trace_taken.store(0, std::memory_order_release);
+    }
+
+    void MudConnection::noteOutput() {
+        auto taken = trace_taken.load(std::memory_order_acquire);
+        if(!taken || trace_answered.load(std::memory_order_relaxed)) return;
+        auto now = latency_clock::now().time_since_epoch();
+        latency_clock::rep expected = 0;
+        if(trace_answered.compare_exchange_strong(expected, now.count()))
+            latency.record(LatencyGame, now - latency_clock::duration(taken));
+    }
+
+    void MudConnection::noteFlushed() {
+        auto answered = trace_answered.exchange(0);
+        if(!answered) return;
+        auto now = latency_clock::now().time_since_epoch();
+        latency.record(LatencyNetOut, now - latency_clock::duration(answered));
+        latency.record(LatencyTotal, now - latency_clock::duration(trace_read.load(std::memory_order_relaxed)));
+        trace_taken.store(0, std::memory_order_release);
+    }
+
+    boost::asio::awaitable<opt_type<GameMsg>> MudConnection::readLine() {
+        GameMsg g;
+        boost::system::error_code ec;
+        while(!takeInput(g)) {
+            if(!active) co_return std::nullopt;
+            co_await boost::asio::post(conn_strand, boost::asio::use_awaitable);
+            if(armWake()) co_await wake_timer->async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        }
+        co_return g;
+    }
+
+    boost::asio::awaitable<void> MudConnection::flush() {
+        boost::system::error_code ec;
+        while(active && !flushed()) {
+            co_await boost::asio::post(conn_strand, boost::asio::use_awaitable);
+            if(armWake()) co_await wake_timer->async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        }
+    }
+
+    bool MudConnection::armWake() {
+        // something changed since the caller last looked. go look again.
+        if(woken) {
+            woken = false;
+            return false;
+        }
+        if(!wake_timer) wake_timer = std::make_unique<boost::asio::steady_timer>(conn_strand.context());
+        wake_timer->expires_at(boost::asio::steady_timer::time_point::max());
+        waiting = true;
+        return true;
+    }
+
+    void MudConnection::wake() {
+        // nothing can be waiting on a connection that was never handed out, or that's being freed. the
+        // close paths call this right before the last reference goes, so hold one across the post.
+        std::weak_ptr<MudConnection> self = weak_from_this();
+        auto held = self.lock();
+        if(!held) return;
+        conn_strand.post(timed("wake", [self] {
+            auto conn = self.lock();
+            if(!conn) return;
+            if(!conn->waiting) {
+                conn->woken = true;
+                return;
+            }
+            conn->waiting = false;
+            conn->wake_timer->cancel();
+        }));
+    }
+
+    void MudConnection::resolvedHost(std::string name) {
+        // details are the strand's to change, like everything else learned about the client.
+        std::weak_ptr<MudConnection> self = weak_from_this();
+        conn_strand.post(timed("resolve", [self, name = std::move(name)]() mutable {
+            if(auto conn = self.lock()) conn->details.hostName = std::move(name);
+        }));
+    }
+
+    void MudConnection::releaseOutput() {}
+
+    bool MudConnection::flushed() {
+        return true;
+    }
+
     nlohmann::json MudConnection::serialize() {
         nlohmann::json j;
         j["details"] = details.serialize();
@@ -29,20 +151,45 @@ namespace ring::net {
         return j;
     }
 
+    std::size_t MudConnection::heapBytes() {
+        return stringHeap(conn_id) + details.heapBytes() + game_messages.capacity() * sizeof(GameMsg)
+            + (wake_timer ? sizeof(boost::asio::steady_timer) : 0);
+    }
+
     void MudConnection::loadJson(nlohmann::json &j) {
         details.load(j["details"]);
         conn_id = j["conn_id"];
     }
 
+    client_details::client_details() : utf8(false), screen_reader(false), proxy(false), osc_color_palette(false),
+    vt100(false), mouse_tracking(false), naws(false), msdp(false), gmcp(false),
+    mccp2(false), mccp2_active(false), mccp3(false), mccp3_active(false), telopt_eor(false),
+    mtts(false), ttype(false), mnes(false), suppress_ga(false), mslp(false),
+    force_endline(false), linemode(false), mssp(false), mxp(false), mxp_active(false) {}
+
+    std::size_t client_details::heapBytes() const {
+        return stringHeap(clientName) + stringHeap(clientVersion) + stringHeap(hostIp) + stringHeap(hostName);
+    }
+
+    ColorType client_details::renderColor() const {
+        return screen_reader ? NoColor : colorType;
+    }
+
     void client_details::load(nlohmann::json &j) {
         clientType = j["clientType"];
         colorType = j["colorType"];
+        if(j.contains("charset")) charset = j["charset"];
         clientName = j["clientName"];
         clientVersion = j["clientVersion"];
         hostIp = j["hostIp"];
         hostName = j["hostName"];
         width = j["width"];
         height = j["height"];
+        if(j.contains("peer_pid")) {
+            peer_pid = j["peer_pid"];
+            peer_uid = j["peer_uid"];
+            peer_gid = j["peer_gid"];
+        }
         utf8 = j["utf8"];
         screen_reader = j["screen_reader"];
         proxy = j["proxy"];
@@ -71,35 +218,41 @@ namespace ring::net {
         nlohmann::json j = {
                 {"clientType", clientType},
                 {"colorType", colorType},
+                {"charset", charset},
                 {"clientName", clientName},
                 {"clientVersion", clientVersion},
                 {"hostIp", hostIp},
                 {"hostName", hostName},
                 {"width", width},
                 {"height", height},
-                {"utf8", utf8},
-                {"screen_reader", screen_reader},
-                {"proxy", proxy},
-                {"osc_color_palette", osc_color_palette},
-                {"vt100", vt100},
-                {"mouse_tracking", mouse_tracking},
-                {"naws", naws},
-                {"msdp", msdp},
-                {"gmcp", gmcp},
-                {"mccp2", mccp2},
-                {"mccp2_active", mccp2_active},
-                {"mccp3", mccp3},
-                {"mccp3_active", mccp3_active},
-                {"mtts", mtts},
-                {"ttype", ttype},
-                {"mnes", mnes},
-                {"suppress_ga", suppress_ga},
-                {"force_endline", force_endline},
-                {"linemode", linemode},
-                {"mssp", mssp},
-                {"mxp", mxp},
-                {"mxp_active", mxp_active}
+                {"utf8", bool(utf8)},
+                {"screen_reader", bool(screen_reader)},
+                {"proxy", bool(proxy)},
+                {"osc_color_palette", bool(osc_color_palette)},
+                {"vt100", bool(vt100)},
+                {"mouse_tracking", bool(mouse_tracking)},
+                {"naws", bool(naws)},
+                {"msdp", bool(msdp)},
+                {"gmcp", bool(gmcp)},
+                {"mccp2", bool(mccp2)},
+                {"mccp2_active", bool(mccp2_active)},
+                {"mccp3", bool(mccp3)},
+                {"mccp3_active", bool(mccp3_active)},
+                {"mtts", bool(mtts)},
+                {"ttype", bool(ttype)},
+                {"mnes", bool(mnes)},
+                {"suppress_ga", bool(suppress_ga)},
+                {"force_endline", bool(force_endline)},
+                {"linemode", bool(linemode)},
+                {"mssp", bool(mssp)},
+                {"mxp", bool(mxp)},
+                {"mxp_active", bool(mxp_active)}
         };
+        if(peer_pid) {
+            j["peer_pid"] = peer_pid;
+            j["peer_uid"] = peer_uid;
+            j["peer_gid"] = peer_gid;
+        }
         return j;
     }
 
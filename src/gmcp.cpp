@@ -0,0 +1,55 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/gmcp.h"
+#include <algorithm>
+#include <cctype>
+
+namespace ring::net {
+
+    void splitGMCP(std::string_view msg, std::string_view &package, std::string_view &data) {
+        auto space = msg.find(' ');
+        package = msg.substr(0, space);
+        data = space == std::string_view::npos ? std::string_view() : msg.substr(space + 1);
+    }
+
+    bool gmcp_routes::ci_less::operator()(std::string_view a, std::string_view b) const {
+        auto n = std::min(a.size(), b.size());
+        for(std::size_t i = 0; i < n; i++) {
+            auto x = std::tolower(static_cast<unsigned char>(a[i])), y = std::tolower(static_cast<unsigned char>(b[i]));
+            if(x != y) return x < y;
+        }
+        return a.size() < b.size();
+    }
+
+    void gmcp_routes::subscribe(const std::string &package) {
+        std::unique_lock<std::shared_mutex> guard(routes_mutex);
+        packages.insert(package);
+    }
+
+    void gmcp_routes::unsubscribe(const std::string &package) {
+        std::unique_lock<std::shared_mutex> guard(routes_mutex);
+        auto found = packages.find(std::string_view(package));
+        if(found != packages.end()) packages.erase(found);
+    }
+
+    bool gmcp_routes::wants(std::string_view package) {
+        std::shared_lock<std::shared_mutex> guard(routes_mutex);
+        if(packages.empty()) return false;
+        // "Char.Items.List", then "Char.Items", then "Char".
+        while(!package.empty()) {
+            if(packages.find(package) != packages.end()) return true;
+            auto dot = package.rfind('.');
+            if(dot == std::string_view::npos) break;
+            package = package.substr(0, dot);
+        }
+        return false;
+    }
+
+    std::vector<std::string> gmcp_routes::subscribed() {
+        std::shared_lock<std::shared_mutex> guard(routes_mutex);
+        return {packages.begin(), packages.end()};
+    }
+
+}
@@ -0,0 +1,67 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/handler_alloc.h"
+#include <cstring>
+
+namespace ring::net {
+
+    namespace {
+        // 64, 128, 256 and 512 bytes. handler storage for a lambda capturing this is well under the first.
+        constexpr std::size_t size_classes = 4, smallest = 64, per_class = 32;
+
+        struct handler_cache {
+            void *blocks[size_classes][per_class];
+            std::size_t count[size_classes] = {};
+            // handlers can still be let go during thread exit, after the cache is gone.
+            bool alive = true;
+            ~handler_cache() {
+                alive = false;
+                for(std::size_t c = 0; c < size_classes; c++)
+                    for(std::size_t i = 0; i < count[c]; i++) ::operator delete(blocks[c][i]);
+            }
+        };
+
+        thread_local handler_cache cache;
+
+        // the class a size falls in, or size_classes if it's too big for any of them.
+        std::size_t classFor(std::size_t size) {
+            std::size_t c = 0, cap = smallest;
+            while(c < size_classes && size > cap) {
+                c++;
+                cap *= 2;
+            }
+            return c;
+        }
+    }
+
+    void *handler_memory::allocate(std::size_t size) {
+        auto c = classFor(size);
+        if(c == size_classes) return ::operator new(size);
+        if(cache.alive && cache.count[c]) return cache.blocks[c][--cache.count[c]];
+        // always the full class size, so the block can serve anything else in the class later.
+        return ::operator new(smallest << c);
+    }
+
+    void handler_memory::deallocate(void *p, std::size_t size) {
+        auto c = classFor(size);
+        if(c < size_classes && cache.alive && cache.count[c] < per_class) {
+            cache.blocks[c][cache.count[c]++] = p;
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    void handler_memory::warm() {
+        if(!cache.alive) return;
+        for(std::size_t c = 0; c < size_classes; c++) {
+            while(cache.count[c] < per_class) {
+                auto block = ::operator new(smallest << c);
+                memset(block, 0, smallest << c);
+                cache.blocks[c][cache.count[c]++] = block;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,110 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/lag.h"
+
+namespace ring::net {
+
+    lag_monitor lag;
+
+    namespace {
+        void raise(std::atomic<uint64_t> &worst, std::atomic<const char*> &who, uint64_t ns, const char *tag) {
+            // only the owning thread raises it, so a plain compare is enough. a check resetting it
+            // at the same moment can lose one sample, which is fine for a monitor.
+            if(ns <= worst.load(std::memory_order_relaxed)) return;
+            worst.store(ns, std::memory_order_relaxed);
+            who.store(tag, std::memory_order_relaxed);
+        }
+
+        double micros(uint64_t ns) {
+            return ns / 1000.0;
+        }
+    }
+
+    thread_lag *lag_monitor::local() {
+        thread_local lag_monitor *owner = nullptr;
+        thread_local thread_lag *mine = nullptr;
+        if(owner != this) {
+            std::lock_guard<std::mutex> guard(list_mutex);
+            threads.push_back(std::make_unique<thread_lag>());
+            mine = threads.back().get();
+            mine->index = threads.size() - 1;
+            owner = this;
+        }
+        return mine;
+    }
+
+    void lag_monitor::sampleDelay(const char *tag, latency_clock::duration d) {
+        auto ns = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        auto t = local();
+        t->delay.record(ns);
+        raise(t->window_delay, t->delay_tag, ns, tag);
+    }
+
+    void lag_monitor::sampleRun(const char *tag, latency_clock::duration d) {
+        auto ns = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        auto t = local();
+        t->run.record(ns);
+        t->handlers.store(t->handlers.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        raise(t->window_run, t->run_tag, ns, tag);
+    }
+
+    void lag_monitor::check() {
+        auto warn_delay = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(config.warn_delay).count());
+        auto warn_run = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(config.warn_run).count());
+        std::lock_guard<std::mutex> guard(list_mutex);
+        for(auto &t : threads) {
+            t->last_delay = t->window_delay.exchange(0);
+            t->last_delay_tag = t->delay_tag.load();
+            t->last_run = t->window_run.exchange(0);
+            t->last_run_tag = t->run_tag.load();
+            if(warn_delay && t->last_delay > warn_delay)
+                std::cerr << "Executor lag: thread " << t->index << " ran a " << (t->last_delay_tag ? t->last_delay_tag : "handler")
+                          << " " << t->last_delay / 1e6 << "ms after it was posted." << std::endl;
+            if(warn_run && t->last_run > warn_run)
+                std::cerr << "Executor lag: thread " << t->index << " spent " << t->last_run / 1e6 << "ms in one "
+                          << (t->last_run_tag ? t->last_run_tag : "handler") << "." << std::endl;
+        }
+    }
+
+    nlohmann::json lag_monitor::serialize() {
+        nlohmann::json j = nlohmann::json::array();
+        std::lock_guard<std::mutex> guard(list_mutex);
+        for(auto &t : threads) {
+            std::array<uint64_t, latency_histogram::bucket_count> delays{};
+            t->delay.addTo(delays);
+            uint64_t count = 0;
+            for(auto c : delays) count += c;
+            auto percentile = [&](double p) {
+                return micros(latency_histogram::percentile(delays, count, p));
+            };
+            nlohmann::json th = {
+                    {"thread", t->index},
+                    {"handlers", t->handlers.load()},
+                    {"max_delay_us", micros(t->last_delay)},
+                    {"max_delay_tag", t->last_delay_tag ? t->last_delay_tag : ""},
+                    {"max_run_us", micros(t->last_run)},
+                    {"max_run_tag", t->last_run_tag ? t->last_run_tag : ""}
+            };
+            if(count) {
+                th["delay_p50_us"] = percentile(0.5);
+                th["delay_p99_us"] = percentile(0.99);
+                th["delay_max_us"] = percentile(1.0);
+            }
+            j.push_back(th);
+        }
+        return j;
+    }
+
+    lag_scope::lag_scope(const char *tag, latency_clock::time_point posted) : tag(tag) {
+        if(!lag.enabled) return;
+        began = latency_clock::now();
+        if(posted != latency_clock::time_point{}) lag.sampleDelay(tag, began - posted);
+    }
+
+    lag_scope::~lag_scope() {
+        if(began != latency_clock::time_point{}) lag.sampleRun(tag, latency_clock::now() - began);
+    }
+
+}
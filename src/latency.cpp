@@ -0,0 +1,93 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/latency.h"
+
+namespace ring::net {
+
+    latency_tracker latency;
+
+    namespace {
+        constexpr const char *segment_names[LatencySegments] = {"net_in", "queue", "game", "net_out", "total"};
+        constexpr uint64_t max_tracked = (uint64_t(1) << 40) - 1;
+    }
+
+    std::size_t latency_histogram::bucketFor(uint64_t ns) {
+        if(ns < 2 * sub_buckets) return ns;
+        ns = std::min(ns, max_tracked);
+        // keep the top six bits: the leading one, and five that pick the sub-bucket.
+        int shift = 63 - __builtin_clzll(ns) - 5;
+        return 2 * sub_buckets + (shift - 1) * sub_buckets + ((ns >> shift) - sub_buckets);
+    }
+
+    uint64_t latency_histogram::valueOf(std::size_t bucket) {
+        if(bucket < 2 * sub_buckets) return bucket;
+        auto shift = (bucket - 2 * sub_buckets) / sub_buckets + 1;
+        auto top = (bucket - 2 * sub_buckets) % sub_buckets + sub_buckets;
+        return (top << shift) + (uint64_t(1) << (shift - 1));
+    }
+
+    uint64_t latency_histogram::percentile(const std::array<uint64_t, bucket_count> &totals, uint64_t count, double p) {
+        auto want = std::max<uint64_t>(1, static_cast<uint64_t>(p * count + 0.5));
+        uint64_t seen = 0;
+        for(std::size_t i = 0; i < totals.size(); i++) {
+            seen += totals[i];
+            if(seen >= want) return valueOf(i);
+        }
+        return 0;
+    }
+
+    void latency_histogram::record(uint64_t ns) {
+        auto &c = counts[bucketFor(ns)];
+        // only the owning thread writes, so there's no need for an atomic add.
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    void latency_histogram::addTo(std::array<uint64_t, bucket_count> &totals) const {
+        for(std::size_t i = 0; i < bucket_count; i++) totals[i] += counts[i].load(std::memory_order_relaxed);
+    }
+
+    latency_tracker::thread_histograms *latency_tracker::local() {
+        thread_local latency_tracker *owner = nullptr;
+        thread_local thread_histograms *mine = nullptr;
+        if(owner != this) {
+            std::lock_guard<std::mutex> guard(list_mutex);
+            threads.push_back(std::make_unique<thread_histograms>());
+            mine = threads.back().get();
+            owner = this;
+        }
+        return mine;
+    }
+
+    void latency_tracker::record(LatencySegment segment, latency_clock::duration d) {
+        if(!enabled) return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        local()->segments[segment].record(ns > 0 ? ns : 0);
+    }
+
+    nlohmann::json latency_tracker::serialize() {
+        nlohmann::json j;
+        std::lock_guard<std::mutex> guard(list_mutex);
+        for(std::size_t s = 0; s < LatencySegments; s++) {
+            std::array<uint64_t, latency_histogram::bucket_count> totals{};
+            for(auto &t : threads) t->segments[s].addTo(totals);
+            uint64_t count = 0;
+            for(auto c : totals) count += c;
+
+            auto &out = j[segment_names[s]];
+            out["count"] = count;
+            if(!count) continue;
+            auto percentile = [&](double p) {
+                return latency_histogram::percentile(totals, count, p) / 1000.0;
+            };
+            out["p50_us"] = percentile(0.5);
+            out["p90_us"] = percentile(0.9);
+            out["p99_us"] = percentile(0.99);
+            out["p999_us"] = percentile(0.999);
+            out["max_us"] = percentile(1.0);
+        }
+        return j;
+    }
+
+}
@@ -5,46 +5,230 @@
 
 #include "ringnet/net.h"
 #include <random>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 namespace ring::net {
 
+    namespace {
+        // the remote address of an IP socket. false for anything else.
+        bool peerAddress(int fd, boost::asio::ip::address &addr) {
+            sockaddr_storage sa{};
+            socklen_t len = sizeof(sa);
+            if(getpeername(fd, reinterpret_cast<sockaddr*>(&sa), &len)) return false;
+            if(sa.ss_family == AF_INET) {
+                auto in = reinterpret_cast<sockaddr_in*>(&sa);
+                addr = boost::asio::ip::address_v4(ntohl(in->sin_addr.s_addr));
+                return true;
+            }
+            if(sa.ss_family == AF_INET6) {
+                auto in6 = reinterpret_cast<sockaddr_in6*>(&sa);
+                boost::asio::ip::address_v6::bytes_type bytes;
+                memcpy(bytes.data(), in6->sin6_addr.s6_addr, bytes.size());
+                addr = boost::asio::ip::address_v6(bytes, in6->sin6_scope_id);
+                return true;
+            }
+            return false;
+        }
+
+        // who connected to a unix socket. they're fixed at connect time, so asking once is enough.
+        void peerCredentials(int fd, client_details &details) {
+            ucred cred{};
+            socklen_t len = sizeof(cred);
+            if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) return;
+            details.peer_pid = cred.pid;
+            details.peer_uid = cred.uid;
+            details.peer_gid = cred.gid;
+        }
+    }
+
+    int familyCode(int family) {
+        switch(family) {
+            case AF_INET:
+                return 4;
+            case AF_INET6:
+                return 6;
+            default:
+                return 0;
+        }
+    }
+
+    boost::asio::generic::stream_protocol protocolFor(int code) {
+        switch(code) {
+            case 4:
+                return {AF_INET, IPPROTO_TCP};
+            case 6:
+                return {AF_INET6, IPPROTO_TCP};
+            default:
+                return {AF_UNIX, 0};
+        }
+    }
 
-    plain_telnet_listen::plain_telnet_listen(ListenManager &man, boost::asio::ip::tcp::endpoint endp)
-    : manager(man), acceptor(man.executor, endp), listen_strand(man.executor) {}
 
-    plain_telnet_listen::plain_telnet_listen(ListenManager &man, boost::asio::ip::tcp prot, int socket)
-    : acceptor(man.executor, prot, socket), manager(man), listen_strand(man.executor) {}
+    plain_telnet_listen::plain_telnet_listen(ListenManager &man, boost::asio::generic::stream_protocol::endpoint endp)
+    : acceptor(man.executor, endp), manager(man), listen_strand(man.executor), backoff_timer(man.executor) {}
+
+    plain_telnet_listen::plain_telnet_listen(ListenManager &man, boost::asio::generic::stream_protocol prot, int socket)
+    : acceptor(man.executor, prot, socket), manager(man), listen_strand(man.executor), backoff_timer(man.executor) {}
 
     void plain_telnet_listen::do_listen() {
+        if(auto uring = manager.uring.get()) {
+            uring->attach(*this);
+            // a ring too busy to take the accept is backed off from like any other shortage.
+            if(!uring->accept(*this, acceptor.native_handle())) exhausted(EBUSY);
+            return;
+        }
+        acceptor.async_wait(boost::asio::socket_base::wait_read, listen_strand.wrap([this](auto ec) { do_accept(ec); }));
+    }
+
+    void plain_telnet_listen::do_accept(boost::system::error_code ec) {
+        if(ec) {
+            if(ec == boost::asio::error::operation_aborted) return;
+            std::cerr << "Error waiting on telnet listener: " << ec.message() << std::endl;
+        } else {
+            // take everything that's waiting, up to a limit, then go back to waiting.
+            for(std::size_t i = 0; i < manager.accept_batch; i++) {
+                int fd = ::accept(acceptor.native_handle(), nullptr, nullptr);
+                if(fd >= 0) {
+                    backoff = std::chrono::milliseconds(0);
+                    adopt(fd);
+                    continue;
+                }
+                if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO) continue;
+                if(exhausted(errno)) return;
+                if(errno != EAGAIN && errno != EWOULDBLOCK)
+                    std::cerr << "Error accepting telnet connection: " << strerror(errno) << std::endl;
+                break;
+            }
+        }
+        do_listen();
+    }
+
+    bool plain_telnet_listen::exhausted(int err) {
+        if(err != EMFILE && err != ENFILE && err != ENOBUFS && err != ENOMEM && err != EBUSY) return false;
+        // the connection we couldn't take is still in the backlog, so waiting on readiness again would spin.
+        if(!backoff.count())
+            std::cerr << "Out of resources accepting telnet connections: " << strerror(err) << ", backing off." << std::endl;
+        backoff = std::min<std::chrono::milliseconds>(std::max<std::chrono::milliseconds>(backoff * 2, std::chrono::milliseconds(50)),
+                                                      std::chrono::seconds(2));
+        backoff_timer.expires_after(backoff);
+        backoff_timer.async_wait(listen_strand.wrap([this](auto ec) { if(!ec) do_listen(); }));
+        return true;
+    }
+
+    void plain_telnet_listen::adopt(int fd) {
+        // refuse before anything gets allocated for it.
+        boost::asio::ip::address addr;
+        bool local = !path.empty();
+        if(!local) peerAddress(fd, addr);
+        // behind a proxy everything comes from the proxy. admission waits for the real address in the header.
+        // a unix socket is only reachable from this host, so there's nothing to admit it by.
+        if(!local && !proxy_protocol && !manager.admission.admit(addr, manager.admission_limits)) {
+            close(fd);
+            return;
+        }
+
         manager.id_mutex.lock();
         auto new_id = generate_id("telnet", 10, manager.conn_ids);
         manager.id_mutex.unlock();
 
-        queued_connection = new telnet::TcpMudTelnetConnection(new_id, manager.executor);
-
-        acceptor.async_accept(queued_connection->_socket, [this](auto ec) { do_accept(ec); });
+        auto conn = new telnet::TcpMudTelnetConnection(new_id, manager.executor, acceptor.local_endpoint().protocol(), fd);
+        if(local) {
+            conn->details.clientType = UnixTelnet;
+            conn->details.hostIp = "unix:" + path;
+            conn->details.hostName = "localhost";
+            peerCredentials(fd, conn->details);
+        } else {
+            conn->details.hostIp = addr.to_string();
+        }
+        if(proxy_protocol) {
+            conn->expect_proxy = true;
+            accepted(conn);
+            return;
+        }
+        if(local) {
+            accepted(conn);
+            return;
+        }
+        conn->peer = addr;
+        conn->admitted = true;
+        accepted(conn);
+        if(manager.resolve_hostnames) manager.lookupHost(new_id, addr);
     }
 
-    void plain_telnet_listen::do_accept(std::error_code ec) {
-        if(ec) {
-            // Oops, something bad happened. handle it!
-        }
+    void plain_telnet_listen::accepted(telnet::TcpMudTelnetConnection *conn) {
         manager.conn_mutex.lock();
-        manager.connections.emplace(queued_connection->conn_id, queued_connection);
+        manager.connections.emplace(conn->conn_id, conn);
         manager.conn_mutex.unlock();
-        queued_connection->start();
-        do_listen();
+        conn->start();
+    }
+
+    void plain_telnet_listen::onUringAccept(int res, bool more) {
+        // the ring's thread isn't ours. backoff and adopt() belong to the strand, as they do on the reactor.
+        listen_strand.post(timed("listen", [this, res, more] {
+            if(res >= 0) {
+                backoff = std::chrono::milliseconds(0);
+                adopt(res);
+            } else if(exhausted(-res)) {
+                // the multishot accept is over, exhausted() restarts it once the backoff runs out.
+                return;
+            }
+            // the kernel ends a multishot accept on errors. start another one.
+            if(!more) do_listen();
+        }));
     }
 
     void plain_telnet_listen::listen() {
+        boost::system::error_code ec;
+        acceptor.non_blocking(true, ec);
+        listen_strand.post(timed("listen", [this] { do_listen(); }));
+    }
 
-        listen_strand.post([this] { do_listen(); });
+    ListenManager::ListenManager() : events(128) {
+        auto count = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+        for(unsigned int i = 0; i < count; i++) {
+            wheels.emplace_back(new timing_wheel(executor));
+        }
+    };
+
+    ListenManager::~ListenManager() {
+        if(portal) portal->stop();
+        resolver.stop();
+        // connections unhook themselves from the wheels and the ring, so they have to go first.
+        connections.clear();
     }
 
-    ListenManager::ListenManager() : events(128) {};
+    timing_wheel& ListenManager::wheelFor(const std::string &conn_id) {
+        return *wheels[std::hash<std::string>()(conn_id) % wheels.size()];
+    }
 
     bool ListenManager::readyTLS() {return false;};
 
+    bool ListenManager::enableIoUring() {
+        if(uring) return true;
+        if(!uring_backend::supported()) {
+            std::cerr << "io_uring is not supported by this kernel, staying on the reactor." << std::endl;
+            return false;
+        }
+        auto backend = std::make_unique<uring_backend>(executor);
+        if(!backend->ready()) {
+            std::cerr << "io_uring setup failed, staying on the reactor." << std::endl;
+            return false;
+        }
+        backend->start();
+        uring = std::move(backend);
+        return true;
+    }
+
+    bool ListenManager::enablePortal(const std::string &name, uint64_t capacity) {
+        if(portal) return true;
+        auto p = std::make_unique<portal_server>(*this);
+        if(!p->open(name, capacity)) return false;
+        p->start();
+        portal = std::move(p);
+        return true;
+    }
+
     boost::asio::ip::address ListenManager::parse_addr(const std::string &ip) {
         std::error_code ec;
         auto ip_address = boost::asio::ip::address::from_string(ip);
@@ -64,14 +248,52 @@ namespace ring::net {
         return boost::asio::ip::tcp::endpoint(parse_addr(ip), port);
     }
 
-    bool ListenManager::listenPlainTelnet(const std::string& ip, uint16_t port) {
+    bool ListenManager::listenPlainTelnet(const std::string& ip, uint16_t port, bool proxy) {
         auto endp = create_endpoint(ip, port);
         auto listener = new plain_telnet_listen(*this, endp);
+        listener->proxy_protocol = proxy;
         plain_telnet_listeners.emplace(port, listener);
         listener->listen();
         return true;
     }
 
+    bool ListenManager::listenUnixTelnet(const std::string &path, bool proxy) {
+        if(unix_telnet_listeners.count(path)) {
+            std::cerr << "Unix socket is already in use: " << path << std::endl;
+            return false;
+        }
+        if(path.size() >= sizeof(sockaddr_un::sun_path)) {
+            std::cerr << "Unix socket path is too long: " << path << std::endl;
+            return false;
+        }
+        // a socket file left behind by an earlier run would make the bind fail. one that still has a listener
+        // behind it belongs to a running server, and anything else at the path is left alone.
+        boost::asio::local::stream_protocol::endpoint endp(path);
+        struct stat st{};
+        if(!lstat(path.c_str(), &st) && S_ISSOCK(st.st_mode)) {
+            boost::asio::local::stream_protocol::socket probe(executor);
+            boost::system::error_code ec;
+            probe.connect(endp, ec);
+            if(!ec) {
+                std::cerr << "Unix socket is already being listened on: " << path << std::endl;
+                return false;
+            }
+            if(ec == boost::asio::error::connection_refused) unlink(path.c_str());
+        }
+        std::unique_ptr<plain_telnet_listen> listener;
+        try {
+            listener = std::make_unique<plain_telnet_listen>(*this, endp);
+        } catch(const boost::system::system_error &e) {
+            std::cerr << "Failed to listen on unix socket " << path << ": " << e.what() << std::endl;
+            return false;
+        }
+        listener->proxy_protocol = proxy;
+        listener->path = path;
+        listener->listen();
+        unix_telnet_listeners.emplace(path, std::move(listener));
+        return true;
+    }
+
     bool ListenManager::listenTLSTelnet(const std::string& ip, uint16_t port) {
         return false;
     }
@@ -81,6 +303,7 @@ namespace ring::net {
     }
 
     ListenManager manager;
+    thread_local bool hold_output = false;
 
     void ListenManager::run(int threads) {
 
@@ -88,11 +311,18 @@ namespace ring::net {
         if(thread_count < 1)
             thread_count = std::thread::hardware_concurrency();
 
-        // quick and dirty
-        for(int i = 0; i < thread_count - 1; i++) {
-            manager.threads.emplace_back([this](){executor.run();});
+        start();
+        placement.configure(affinity);
+
+        // the calling thread is executor thread 0.
+        for(int i = 1; i < thread_count; i++) {
+            manager.threads.emplace_back([this, i](){
+                placement.enter(i);
+                executor.run();
+            });
         }
 
+        placement.enter(0);
         executor.run();
 
         for(auto &t : manager.threads) {
@@ -102,19 +332,69 @@ namespace ring::net {
 
     }
 
+    bool ListenManager::pinGame() {
+        return affinity.game_cpu >= 0 && pinThread({affinity.game_cpu});
+    }
+
+    void ListenManager::start() {
+        std::call_once(start_once, [this] {
+            for(auto &w : wheels) w->start();
+            if(resolve_hostnames) resolver.start(dns);
+            if(lag.config.interval.count()) {
+                lag_timer = std::make_unique<boost::asio::steady_timer>(executor);
+                checkLag();
+            }
+        });
+    }
+
+    void ListenManager::checkLag() {
+        lag_timer->expires_after(lag.config.interval);
+        lag_timer->async_wait(recycled([this](auto ec) {
+            if(ec) return;
+            // the timer doubles as a probe: how late it fires is how backed up the executor is.
+            lag.sampleDelay("lag probe", latency_clock::now() - lag_timer->expiry());
+            lag.check();
+            checkLag();
+        }));
+    }
+
+    std::size_t ListenManager::poll(std::chrono::microseconds budget) {
+        if(!running) return 0;
+        start();
+        if(executor.stopped()) executor.restart();
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        std::size_t ran = 0;
+        while(std::chrono::steady_clock::now() < deadline && executor.poll_one()) ran++;
+        return ran;
+    }
+
     nlohmann::json ListenManager::copyover() {
         executor.stop();
         auto j = serialize();
         running = false;
+        // whatever is still in the rings would go with this process.
+        capture.close();
         return j;
     }
 
+    void ListenManager::lookupHost(const std::string &conn_id, const boost::asio::ip::address &addr) {
+        resolver.resolve(addr, [this, conn_id](const std::string &name) {
+            if(name.empty()) return;
+            std::lock_guard<std::mutex> guard(conn_mutex);
+            auto found = connections.find(conn_id);
+            if(found != connections.end()) found->second->resolvedHost(name);
+        });
+    }
+
     void ListenManager::closeConn(std::string &conn_id) {
         conn_mutex.lock();
         auto f = connections.find(conn_id);
         if(f != connections.end()) {
             f->second->onClose();
-            connections.erase(conn_id);
+            // onClose() cancels whatever the connection had pending, and those handlers still point at it.
+            // they're queued now, so let the last reference go behind them.
+            boost::asio::post(executor, recycled([c = f->second] {}));
+            connections.erase(f);
         }
         conn_mutex.unlock();
     }
@@ -122,28 +402,50 @@ namespace ring::net {
     nlohmann::json ListenManager::serialize() {
         nlohmann::json j;
         j["plainTelnetListeners"] = serializePlainTelnetListeners();
+        j["unixTelnetListeners"] = serializeUnixTelnetListeners();
         j["connections"] = serializeConnections();
         return j;
     }
 
+    nlohmann::json ListenManager::memoryReport() {
+        std::lock_guard<std::mutex> guard(conn_mutex);
+        std::size_t total = 0;
+        for(const auto &c : connections) total += c.second->memoryFootprint();
+        nlohmann::json j = {
+                {"connections", connections.size()},
+                {"total_bytes", total},
+                {"bytes_per_connection", connections.empty() ? 0 : total / connections.size()}
+        };
+        return j;
+    }
+
     nlohmann::json ListenManager::serializePlainTelnetListeners() {
         auto j = nlohmann::json::array();
         for(const auto& t : plain_telnet_listeners) {
             nlohmann::json j2 = {
                     {"socket", t.second->acceptor.native_handle()},
-                    {"port", t.first}
+                    {"port", t.first},
+                    {"proxy", t.second->proxy_protocol}
             };
-            if(t.second->acceptor.local_endpoint().protocol() == boost::asio::ip::tcp::v4()) {
-                j2["protocol_type"] = 4;
-            } else {
-                j2["protocol_type"] = 6;
-            }
+            j2["protocol_type"] = familyCode(t.second->acceptor.local_endpoint().protocol().family());
 
             j.push_back(j2);
         }
         return j;
     }
 
+    nlohmann::json ListenManager::serializeUnixTelnetListeners() {
+        auto j = nlohmann::json::array();
+        for(const auto& t : unix_telnet_listeners) {
+            j.push_back({
+                    {"socket", t.second->acceptor.native_handle()},
+                    {"path", t.first},
+                    {"proxy", t.second->proxy_protocol}
+            });
+        }
+        return j;
+    }
+
     nlohmann::json ListenManager::serializeConnections() {
         auto j = nlohmann::json::array();
         for(const auto& t : connections) {
@@ -158,6 +460,10 @@ namespace ring::net {
             loadPlainTelnetListeners(json.at("plainTelnetListeners"));
         }
 
+        if(json.contains("unixTelnetListeners")) {
+            loadUnixTelnetListeners(json.at("unixTelnetListeners"));
+        }
+
         if(json.contains("connections")) {
             loadConnections(json.at("connections"));
         }
@@ -166,6 +472,10 @@ namespace ring::net {
             l.second->listen();
         }
 
+        for(auto &l : unix_telnet_listeners) {
+            l.second->listen();
+        }
+
         for(auto &c : connections) {
             c.second->resume();
         }
@@ -175,19 +485,31 @@ namespace ring::net {
         for(const auto &j2 : j) {
             int socket = j2["socket"];
             int prot = j2["protocol_type"];
-            auto p = new plain_telnet_listen(*this, prot==4 ? boost::asio::ip::tcp::v4() : boost::asio::ip::tcp::v6(), socket);
+            auto p = new plain_telnet_listen(*this, protocolFor(prot), socket);
             int port = j2["port"];
+            if(j2.contains("proxy")) p->proxy_protocol = j2["proxy"];
             ports.insert(port);
             plain_telnet_listeners.emplace(port, p);
         }
     }
 
+    void ListenManager::loadUnixTelnetListeners(nlohmann::json &j) {
+        for(const auto &j2 : j) {
+            int socket = j2["socket"];
+            auto p = new plain_telnet_listen(*this, protocolFor(0), socket);
+            p->path = j2["path"];
+            p->proxy_protocol = j2["proxy"];
+            unix_telnet_listeners.emplace(p->path, p);
+        }
+    }
+
     void ListenManager::loadConnections(nlohmann::json &j) {
         for(auto &j2 : j) {
             std::string conn_id = j2["conn_id"];
             net::ClientType c = j2["details"]["clientType"];
             switch(c) {
                 case ring::net::TcpTelnet:
+                case ring::net::UnixTelnet:
                     loadPlainTelnet(j2);
                     break;
                 case ring::net::TlsTelnet:
@@ -202,9 +524,19 @@ namespace ring::net {
     void ListenManager::loadPlainTelnet(nlohmann::json &j) {
         std::string conn_id = j["conn_id"];
         int prot = j["protocol"];
-        boost::asio::ip::tcp p = prot ? boost::asio::ip::tcp::v4() : boost::asio::ip::tcp::v6();
         int socket = j["socket"];
-        auto c = new telnet::TcpMudTelnetConnection(conn_id, executor, j, p, socket);
+        auto c = new telnet::TcpMudTelnetConnection(conn_id, executor, j, protocolFor(prot), socket);
+        boost::system::error_code ec;
+        boost::asio::ip::address addr;
+        // a proxied connection counts against the address from its header, not the proxy's.
+        if(c->details.proxy) addr = boost::asio::ip::make_address(c->details.hostIp, ec);
+        else if(!peerAddress(socket, addr)) ec = boost::asio::error::address_family_not_supported;
+        if(!ec && !c->expect_proxy) {
+            // already in, so it counts against its address whatever the limits say.
+            c->peer = addr;
+            c->admitted = true;
+            admission.track(c->peer);
+        }
         connections.emplace(conn_id, c);
     }
 
@@ -0,0 +1,377 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/portal.h"
+#include "ringnet/net.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ring::net {
+
+    namespace {
+        constexpr uint32_t portal_magic = 0x524E5054; // "RNPT"
+        constexpr uint32_t portal_version = 1;
+
+        struct segment_header {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t capacity;
+            std::atomic<uint64_t> game_generation;
+        };
+
+        constexpr std::size_t segment_header_size = 64;
+        static_assert(sizeof(segment_header) <= segment_header_size);
+
+        struct record_header {
+            uint32_t length; // conn_id plus body
+            uint8_t type;
+            uint8_t extra;
+            uint16_t id_length;
+        };
+        static_assert(sizeof(record_header) == 8);
+
+        constexpr uint64_t align8(uint64_t n) {
+            return (n + 7) & ~uint64_t(7);
+        }
+
+        // how long the portal thread sleeps when there was nothing to do.
+        constexpr auto idle_sleep = std::chrono::microseconds(500);
+    }
+
+    std::size_t shm_ring::footprint(uint64_t capacity) {
+        return sizeof(shm_ring_header) + capacity;
+    }
+
+    void shm_ring::bind(void *memory, uint64_t capacity, bool init) {
+        header = static_cast<shm_ring_header*>(memory);
+        data = static_cast<uint8_t*>(memory) + sizeof(shm_ring_header);
+        if(init) {
+            header->head.store(0);
+            header->tail.store(0);
+            header->capacity = capacity;
+        }
+    }
+
+    bool shm_ring::write(PortalRecord type, uint8_t extra, std::string_view conn_id, std::string_view body) {
+        auto capacity = header->capacity;
+        auto need = align8(sizeof(record_header) + conn_id.size() + body.size());
+        if(conn_id.size() > UINT16_MAX || need > capacity / 2) return false;
+
+        auto tail = header->tail.load(std::memory_order_relaxed);
+        auto head = header->head.load(std::memory_order_acquire);
+        auto offset = tail & (capacity - 1);
+        auto to_end = capacity - offset;
+        auto total = to_end < need ? need + to_end : need;
+        if(capacity - (tail - head) < total) return false;
+
+        if(to_end < need) {
+            record_header pad{static_cast<uint32_t>(to_end - sizeof(record_header)), PortalPad, 0, 0};
+            memcpy(data + offset, &pad, sizeof(pad));
+            tail += to_end;
+            offset = 0;
+        }
+        record_header rec{static_cast<uint32_t>(conn_id.size() + body.size()), type, extra, static_cast<uint16_t>(conn_id.size())};
+        memcpy(data + offset, &rec, sizeof(rec));
+        memcpy(data + offset + sizeof(rec), conn_id.data(), conn_id.size());
+        memcpy(data + offset + sizeof(rec) + conn_id.size(), body.data(), body.size());
+        header->tail.store(tail + need, std::memory_order_release);
+        return true;
+    }
+
+    bool shm_ring::read(portal_message &msg) {
+        auto capacity = header->capacity;
+        auto head = header->head.load(std::memory_order_relaxed);
+        auto tail = header->tail.load(std::memory_order_acquire);
+        while(head != tail) {
+            auto offset = head & (capacity - 1);
+            record_header rec;
+            memcpy(&rec, data + offset, sizeof(rec));
+            head += align8(sizeof(rec) + rec.length);
+            if(rec.type == PortalPad) continue;
+
+            auto payload = reinterpret_cast<const char*>(data + offset + sizeof(rec));
+            msg.type = static_cast<PortalRecord>(rec.type);
+            msg.extra = rec.extra;
+            msg.conn_id.assign(payload, rec.id_length);
+            msg.body.assign(payload + rec.id_length, rec.length - rec.id_length);
+            header->head.store(head, std::memory_order_release);
+            return true;
+        }
+        header->head.store(head, std::memory_order_release);
+        return false;
+    }
+
+    void shm_ring::discard() {
+        header->head.store(header->tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    uint64_t shm_ring::used() const {
+        return header->tail.load(std::memory_order_acquire) - header->head.load(std::memory_order_acquire);
+    }
+
+    portal_segment::~portal_segment() {
+        close();
+    }
+
+    bool portal_segment::create(const std::string &n, uint64_t capacity) {
+        if(!capacity || (capacity & (capacity - 1))) {
+            std::cerr << "Portal ring capacity must be a power of two: " << capacity << std::endl;
+            return false;
+        }
+        name = n;
+        // a segment left behind by a portal that died gets replaced, not reused.
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0) {
+            std::cerr << "Failed to create portal segment " << name << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        size = segment_header_size + 2 * shm_ring::footprint(capacity);
+        if(ftruncate(fd, size)) {
+            std::cerr << "Failed to size portal segment " << name << ": " << strerror(errno) << std::endl;
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(memory == MAP_FAILED) {
+            memory = nullptr;
+            std::cerr << "Failed to map portal segment " << name << ": " << strerror(errno) << std::endl;
+            shm_unlink(name.c_str());
+            return false;
+        }
+        owner = true;
+        auto h = static_cast<segment_header*>(memory);
+        h->capacity = capacity;
+        h->game_generation.store(0);
+        bindRings(true);
+        h->version = portal_version;
+        // last, so a game attaching halfway through setup sees no magic and waits.
+        std::atomic_thread_fence(std::memory_order_release);
+        h->magic = portal_magic;
+        return true;
+    }
+
+    bool portal_segment::attach(const std::string &n) {
+        name = n;
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if(fd < 0) return false;
+        segment_header probe;
+        if(pread(fd, &probe, sizeof(uint32_t) * 2 + sizeof(uint64_t), 0) != sizeof(uint32_t) * 2 + sizeof(uint64_t) ||
+           probe.magic != portal_magic || probe.version != portal_version) {
+            ::close(fd);
+            return false;
+        }
+        size = segment_header_size + 2 * shm_ring::footprint(probe.capacity);
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(memory == MAP_FAILED) {
+            memory = nullptr;
+            return false;
+        }
+        owner = false;
+        bindRings(false);
+        return true;
+    }
+
+    void portal_segment::bindRings(bool init) {
+        auto h = static_cast<segment_header*>(memory);
+        auto base = static_cast<uint8_t*>(memory) + segment_header_size;
+        to_game.bind(base, h->capacity, init);
+        to_portal.bind(base + shm_ring::footprint(h->capacity), h->capacity, init);
+        game_generation = &h->game_generation;
+    }
+
+    void portal_segment::close() {
+        if(memory) munmap(memory, size);
+        memory = nullptr;
+        game_generation = nullptr;
+        if(owner) shm_unlink(name.c_str());
+        owner = false;
+    }
+
+    nlohmann::json portal_stats::serialize() const {
+        nlohmann::json j = {
+                {"records_out", records_out.load()},
+                {"records_in", records_in.load()},
+                {"dropped", dropped.load()},
+                {"resyncs", resyncs.load()}
+        };
+        return j;
+    }
+
+    portal_server::portal_server(ListenManager &man) : manager(man) {}
+
+    portal_server::~portal_server() {
+        stop();
+    }
+
+    bool portal_server::open(const std::string &name, uint64_t capacity) {
+        return segment.create(name, capacity);
+    }
+
+    void portal_server::start() {
+        if(running.exchange(true)) return;
+        worker = std::thread([this] { run(); });
+    }
+
+    void portal_server::stop() {
+        if(!running.exchange(false)) return;
+        if(worker.joinable()) worker.join();
+    }
+
+    bool portal_server::send(PortalRecord type, uint8_t extra, std::string_view conn_id, std::string_view body) {
+        std::lock_guard<std::mutex> guard(write_mutex);
+        if(segment.to_game.write(type, extra, conn_id, body)) {
+            stats.records_out++;
+            return true;
+        }
+        // no game, or one that's fallen behind. a lost line of input is like one the throttle dropped, but
+        // losing an event or details would leave the game wrong about who's connected until it's resynced.
+        stats.dropped++;
+        if(type != PortalInput && type != PortalGMCP) resync_pending = true;
+        return false;
+    }
+
+    bool portal_server::input(const std::string &conn_id, const std::string &line) {
+        return send(PortalInput, 0, conn_id, line);
+    }
+
+    bool portal_server::gmcp(const std::string &conn_id, const std::string &package, const std::string &data) {
+        return send(PortalGMCP, 0, conn_id, data.empty() ? package : package + ' ' + data);
+    }
+
+    void portal_server::run() {
+        int idle = 0;
+        while(running) {
+            if(pump()) {
+                idle = 0;
+            } else if(++idle > 64) {
+                // spin a little first, then back off so a quiet portal isn't burning a core.
+                std::this_thread::sleep_for(idle_sleep);
+            }
+        }
+    }
+
+    bool portal_server::pump() {
+        bool worked = false;
+        // wait for the game to catch up first, or the resync would only be dropped in turn.
+        if(resync_pending && segment.to_game.used() == 0) {
+            resync_pending = false;
+            resync(game_generation);
+            worked = true;
+        }
+        ConnectionMsg m;
+        while(manager.events.pop(m)) {
+            worked = true;
+            // the resync will carry it.
+            if(resync_pending) continue;
+            if(m.event == CONNECTED) {
+                std::lock_guard<std::mutex> guard(manager.conn_mutex);
+                auto found = manager.connections.find(m.conn_id);
+                if(found != manager.connections.end()) send(PortalDetails, 0, m.conn_id, found->second->details.serialize().dump());
+            }
+            send(PortalEvent, m.event, m.conn_id, {});
+        }
+        portal_message msg;
+        // a bounded batch, so a chatty game can't starve the events.
+        for(int i = 0; i < 256 && segment.to_portal.read(msg); i++) {
+            worked = true;
+            stats.records_in++;
+            handle(msg);
+        }
+        return worked;
+    }
+
+    void portal_server::handle(const portal_message &msg) {
+        switch(msg.type) {
+            case PortalHello: {
+                uint64_t generation = 0;
+                if(msg.body.size() == sizeof(generation)) memcpy(&generation, msg.body.data(), sizeof(generation));
+                game_generation = generation;
+                resync(generation);
+                break;
+            }
+            case PortalOutput: {
+                std::shared_ptr<MudConnection> conn;
+                {
+                    std::lock_guard<std::mutex> guard(manager.conn_mutex);
+                    auto found = manager.connections.find(msg.conn_id);
+                    if(found != manager.connections.end()) conn = found->second;
+                }
+                if(conn) conn->sendText(msg.body, static_cast<TextType>(msg.extra));
+                break;
+            }
+            case PortalClose: {
+                auto conn_id = msg.conn_id;
+                manager.closeConn(conn_id);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void portal_server::resync(uint64_t generation) {
+        stats.resyncs++;
+        std::string gen(reinterpret_cast<const char*>(&generation), sizeof(generation));
+        send(PortalResyncBegin, 0, {}, gen);
+        {
+            std::lock_guard<std::mutex> guard(manager.conn_mutex);
+            for(auto &c : manager.connections) {
+                if(c.second->active) sendConnection(c.first, *c.second);
+            }
+        }
+        send(PortalResyncEnd, 0, {}, gen);
+    }
+
+    void portal_server::sendConnection(const std::string &conn_id, MudConnection &conn) {
+        send(PortalDetails, 0, conn_id, conn.details.serialize().dump());
+        send(PortalEvent, CONNECTED, conn_id, {});
+    }
+
+    bool portal_client::attach(const std::string &name) {
+        segment.close();
+        if(!segment.attach(name)) return false;
+        // whatever the last game left unread is stale now.
+        segment.to_game.discard();
+        generation = segment.game_generation->fetch_add(1) + 1;
+        synced = false;
+        std::string gen(reinterpret_cast<const char*>(&generation), sizeof(generation));
+        return segment.to_portal.write(PortalHello, 0, {}, gen);
+    }
+
+    bool portal_client::poll(portal_message &msg) {
+        if(!segment.game_generation) return false;
+        while(segment.to_game.read(msg)) {
+            if(!synced) {
+                // skip until the portal answers our hello.
+                uint64_t answered = 0;
+                if(msg.type != PortalResyncBegin || msg.body.size() != sizeof(answered)) continue;
+                memcpy(&answered, msg.body.data(), sizeof(answered));
+                if(answered != generation) continue;
+                synced = true;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool portal_client::send(const std::string &conn_id, const std::string &txt, TextType mode) {
+        if(!segment.game_generation) return false;
+        return segment.to_portal.write(PortalOutput, mode, conn_id, txt);
+    }
+
+    bool portal_client::close(const std::string &conn_id) {
+        if(!segment.game_generation) return false;
+        return segment.to_portal.write(PortalClose, 0, conn_id, {});
+    }
+
+    bool portal_client::resyncing() const {
+        return !synced;
+    }
+
+}
@@ -0,0 +1,121 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/proxy.h"
+#include <string_view>
+
+namespace ring::net {
+
+    namespace {
+        constexpr uint8_t v2_signature[12] = {0x0D, 0x0A, 0x0D, 0x0A, 0x00, 0x0D, 0x0A, 0x51, 0x55, 0x49, 0x54, 0x0A};
+        constexpr std::string_view v1_prefix = "PROXY ";
+        // the longest a v1 header is allowed to be, CRLF included.
+        constexpr std::size_t v1_max = 107;
+
+        uint16_t readShort(const uint8_t *p) {
+            return static_cast<uint16_t>((p[0] << 8) | p[1]);
+        }
+
+        // true while what we have so far could still be the start of prefix.
+        bool couldBe(const uint8_t *data, std::size_t length, const uint8_t *prefix, std::size_t prefix_length) {
+            return !memcmp(data, prefix, std::min(length, prefix_length));
+        }
+
+        bool parsePort(std::string_view s, uint16_t &port) {
+            if(s.empty() || s.size() > 5) return false;
+            unsigned value = 0;
+            for(auto c : s) {
+                if(c < '0' || c > '9') return false;
+                value = value * 10 + (c - '0');
+            }
+            if(value > 65535) return false;
+            port = value;
+            return true;
+        }
+
+        ProxyResult parseV1(const uint8_t *data, std::size_t length, proxy_header &out) {
+            auto text = std::string_view(reinterpret_cast<const char*>(data), std::min(length, v1_max));
+            auto end = text.find("\r\n");
+            if(end == std::string_view::npos) return length >= v1_max ? ProxyInvalid : ProxyIncomplete;
+
+            std::vector<std::string_view> fields;
+            auto line = text.substr(0, end);
+            while(!line.empty()) {
+                auto space = line.find(' ');
+                fields.push_back(line.substr(0, space));
+                if(space == std::string_view::npos) break;
+                line.remove_prefix(space + 1);
+            }
+            out.length = end + 2;
+
+            if(fields.size() >= 2 && fields[1] == "UNKNOWN") {
+                out.local = true;
+                return ProxyDone;
+            }
+            if(fields.size() != 6 || (fields[1] != "TCP4" && fields[1] != "TCP6")) return ProxyInvalid;
+            boost::system::error_code ec;
+            out.source = boost::asio::ip::make_address(std::string(fields[2]), ec);
+            if(ec) return ProxyInvalid;
+            out.destination = boost::asio::ip::make_address(std::string(fields[3]), ec);
+            if(ec) return ProxyInvalid;
+            if(out.source.is_v4() != (fields[1] == "TCP4")) return ProxyInvalid;
+            if(!parsePort(fields[4], out.source_port) || !parsePort(fields[5], out.destination_port)) return ProxyInvalid;
+            return ProxyDone;
+        }
+
+        ProxyResult parseV2(const uint8_t *data, std::size_t length, proxy_header &out) {
+            if(length < 16) return ProxyIncomplete;
+            auto version = data[12] >> 4, command = data[12] & 0x0F;
+            if(version != 2 || command > 1) return ProxyInvalid;
+            std::size_t body = readShort(data + 14);
+            if(length < 16 + body) return ProxyIncomplete;
+            out.length = 16 + body;
+
+            auto family = data[13];
+            auto addr = data + 16;
+            if(command == 0) {
+                out.local = true;
+            } else if(family == 0x11 && body >= 12) {
+                // TCP over IPv4
+                boost::asio::ip::address_v4::bytes_type src, dst;
+                memcpy(src.data(), addr, 4);
+                memcpy(dst.data(), addr + 4, 4);
+                out.source = boost::asio::ip::address_v4(src);
+                out.destination = boost::asio::ip::address_v4(dst);
+                out.source_port = readShort(addr + 8);
+                out.destination_port = readShort(addr + 10);
+            } else if(family == 0x21 && body >= 36) {
+                // TCP over IPv6
+                boost::asio::ip::address_v6::bytes_type src, dst;
+                memcpy(src.data(), addr, 16);
+                memcpy(dst.data(), addr + 16, 16);
+                out.source = boost::asio::ip::address_v6(src);
+                out.destination = boost::asio::ip::address_v6(dst);
+                out.source_port = readShort(addr + 32);
+                out.destination_port = readShort(addr + 34);
+            } else {
+                // UDP, unix sockets or unspecified. nothing we can use, but the header is still valid.
+                out.local = true;
+            }
+            // any TLVs after the addresses are skipped along with the rest of the header.
+            return ProxyDone;
+        }
+    }
+
+    ProxyResult parseProxyHeader(const uint8_t *data, std::size_t length, proxy_header &out) {
+        if(!length) return ProxyIncomplete;
+        out = proxy_header();
+        if(couldBe(data, length, v2_signature, sizeof(v2_signature))) {
+            if(length < sizeof(v2_signature)) return ProxyIncomplete;
+            return parseV2(data, length, out);
+        }
+        auto v1 = reinterpret_cast<const uint8_t*>(v1_prefix.data());
+        if(couldBe(data, length, v1, v1_prefix.size())) {
+            if(length < v1_prefix.size()) return ProxyIncomplete;
+            return parseV1(data, length, out);
+        }
+        return ProxyInvalid;
+    }
+
+}
@@ -0,0 +1,120 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/resolver.h"
+#include <netdb.h>
+
+namespace ring::net {
+
+    std::string lookupHostname(const boost::asio::ip::address &addr) {
+        sockaddr_storage sa{};
+        socklen_t len;
+        if(addr.is_v4()) {
+            auto in = reinterpret_cast<sockaddr_in*>(&sa);
+            in->sin_family = AF_INET;
+            auto bytes = addr.to_v4().to_bytes();
+            memcpy(&in->sin_addr, bytes.data(), bytes.size());
+            len = sizeof(sockaddr_in);
+        } else {
+            auto in6 = reinterpret_cast<sockaddr_in6*>(&sa);
+            in6->sin6_family = AF_INET6;
+            auto bytes = addr.to_v6().to_bytes();
+            memcpy(&in6->sin6_addr, bytes.data(), bytes.size());
+            in6->sin6_scope_id = addr.to_v6().scope_id();
+            len = sizeof(sockaddr_in6);
+        }
+        char host[NI_MAXHOST];
+        // NI_NAMEREQD, so we get nothing back rather than the address formatted as a string.
+        if(getnameinfo(reinterpret_cast<sockaddr*>(&sa), len, host, sizeof(host), nullptr, 0, NI_NAMEREQD)) return {};
+        return host;
+    }
+
+    hostname_resolver::~hostname_resolver() {
+        stop();
+    }
+
+    void hostname_resolver::start(const resolver_config &cfg) {
+        if(pool) return;
+        config = cfg;
+        pool = std::make_unique<boost::asio::thread_pool>(std::max<unsigned>(cfg.threads, 1));
+    }
+
+    void hostname_resolver::stop() {
+        if(!pool) return;
+        pool->stop();
+        pool->join();
+        pool.reset();
+    }
+
+    void hostname_resolver::resolve(const boost::asio::ip::address &addr, callback done) {
+        auto key = addressKey(addr);
+        std::string name;
+        {
+            std::lock_guard<std::mutex> guard(resolver_mutex);
+            if(!find(key, name)) {
+                if(!pool) return;
+                auto &waiting = pending[key];
+                waiting.push_back(std::move(done));
+                // somebody else is already asking about this address.
+                if(waiting.size() > 1) return;
+                boost::asio::post(*pool, [this, key, addr] { finish(key, lookup(addr)); });
+                return;
+            }
+        }
+        done(name);
+    }
+
+    opt_type<std::string> hostname_resolver::cached(const boost::asio::ip::address &addr) {
+        std::lock_guard<std::mutex> guard(resolver_mutex);
+        std::string name;
+        if(find(addressKey(addr), name)) return name;
+        return {};
+    }
+
+    bool hostname_resolver::find(const address_key &key, std::string &name) {
+        auto found = index.find(key);
+        if(found == index.end()) return false;
+        if(found->second->expires <= std::chrono::steady_clock::now()) {
+            order.erase(found->second);
+            index.erase(found);
+            return false;
+        }
+        order.splice(order.begin(), order, found->second);
+        name = found->second->name;
+        return true;
+    }
+
+    void hostname_resolver::store(const address_key &key, const std::string &name) {
+        auto ttl = name.empty() ? config.negative_ttl : config.ttl;
+        auto expires = std::chrono::steady_clock::now() + ttl;
+        auto found = index.find(key);
+        if(found != index.end()) {
+            found->second->name = name;
+            found->second->expires = expires;
+            order.splice(order.begin(), order, found->second);
+            return;
+        }
+        order.push_front({key, name, expires});
+        index.emplace(key, order.begin());
+        if(order.size() > config.cache_size) {
+            index.erase(order.back().key);
+            order.pop_back();
+        }
+    }
+
+    void hostname_resolver::finish(const address_key &key, const std::string &name) {
+        std::vector<callback> waiting;
+        {
+            std::lock_guard<std::mutex> guard(resolver_mutex);
+            store(key, name);
+            auto found = pending.find(key);
+            if(found != pending.end()) {
+                waiting = std::move(found->second);
+                pending.erase(found);
+            }
+        }
+        for(auto &done : waiting) done(name);
+    }
+
+}
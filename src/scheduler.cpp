@@ -0,0 +1,103 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/scheduler.h"
+#include "ringnet/net.h"
+
+namespace ring::net {
+
+    nlohmann::json tick_stats::serialize() const {
+        nlohmann::json j = {
+                {"ticks", ticks.load()},
+                {"overruns", overruns.load()},
+                {"skipped", skipped.load()},
+                {"last_us", last_us.load()},
+                {"max_us", max_us.load()}
+        };
+        return j;
+    }
+
+    tick_scheduler::tick_scheduler(ListenManager &man) : manager(man) {}
+
+    void tick_scheduler::run(const tick_config &cfg, tick_function fn, int threads) {
+        running = true;
+        manager.start();
+        // with no connections and nothing listening the executor would otherwise run dry between ticks.
+        auto work = boost::asio::make_work_guard(manager.executor);
+        std::vector<std::thread> pool;
+        manager.placement.configure(manager.affinity);
+        for(int i = 0; i < threads; i++) pool.emplace_back([this, i] {
+            manager.placement.enter(i);
+            manager.executor.run();
+        });
+        // ticks run here, so with a pool this is the game thread. polling alone, it's the network too.
+        if(!pool.empty()) manager.pinGame();
+        else manager.placement.enter(0);
+
+        auto next = tick_clock::now() + cfg.interval;
+        while(running && manager.running) {
+            if(pool.empty()) manager.executor.run_until(next);
+            else std::this_thread::sleep_until(next);
+            if(!running || !manager.running) break;
+
+            auto behind = tick_clock::now() - next;
+            if(behind > cfg.interval * cfg.max_catchup) {
+                auto missed = behind / cfg.interval;
+                stats.skipped += missed;
+                next += cfg.interval * missed;
+            }
+            tick(fn);
+            next += cfg.interval;
+            if(tick_clock::now() > next) stats.overruns++;
+        }
+
+        work.reset();
+        if(!pool.empty()) {
+            manager.executor.stop();
+            for(auto &t : pool) t.join();
+        }
+    }
+
+    void tick_scheduler::stop() {
+        running = false;
+    }
+
+    void tick_scheduler::tick(const tick_function &fn) {
+        current.number++;
+        current.started = tick_clock::now();
+        collect();
+        hold_output = true;
+        fn(current);
+        hold_output = false;
+        release();
+
+        auto took = std::chrono::duration_cast<std::chrono::microseconds>(tick_clock::now() - current.started).count();
+        stats.ticks++;
+        stats.last_us = took;
+        if(static_cast<uint64_t>(took) > stats.max_us) stats.max_us = took;
+    }
+
+    void tick_scheduler::collect() {
+        current.events.clear();
+        current.input.clear();
+        ConnectionMsg m;
+        while(manager.events.pop(m)) current.events.push_back(std::move(m));
+
+        std::lock_guard<std::mutex> guard(manager.conn_mutex);
+        GameMsg g;
+        for(auto &c : manager.connections) {
+            while(c.second->takeInput(g)) current.input.emplace_back(c.second, std::move(g));
+        }
+    }
+
+    void tick_scheduler::release() {
+        std::lock_guard<std::mutex> guard(manager.conn_mutex);
+        for(auto &c : manager.connections) {
+            // anything this tick took and didn't answer goes untimed.
+            c.second->dropUnanswered();
+            c.second->releaseOutput();
+        }
+    }
+
+}
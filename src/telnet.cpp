@@ -4,20 +4,72 @@
 
 #include <iostream>
 #include <chrono>
+#include <limits>
 #include "ringnet/telnet.h"
 #include "ringnet/net.h"
+#include "ringnet/text.h"
+#include "ringnet/charset.h"
+#include "ringnet/proxy.h"
+#include "ringnet/asset.h"
 #include "boost/algorithm/string.hpp"
 #include "base64_default_rfc4648.hpp"
 
 
 namespace ring::telnet {
-    namespace codes {
+    namespace {
+        template<std::size_t... I>
+        std::array<TelnetOption, sizeof...(I)> makeHandlers(MudTelnetConnection *conn, std::index_sequence<I...>) {
+            return {TelnetOption(conn, options::supported[I])...};
+        }
 
-        const uint8_t NUL = 0, BEL = 7, CR = 13, LF = 10, SGA = 3, TELOPT_EOR = 25, NAWS = 31;
-        const uint8_t LINEMODE = 34, EOR = 239, SE = 240, NOP = 241, GA = 249, SB = 250;
-        const uint8_t WILL = 251, WONT = 252, DO = 253, DONT = 254, IAC = 255, MNES = 39;
-        const uint8_t MXP = 91, MSSP = 70, MCCP2 = 86, MCCP3 = 87, GMCP = 201, MSDP = 69;
-        const uint8_t MTTS = 24;
+        constexpr std::size_t handshake_size = [] {
+            std::size_t n = 0;
+            for(auto c : options::supported) {
+                if(options::flags[c] & options::StartWill) n += 3;
+                if(options::flags[c] & options::StartDo) n += 3;
+            }
+            return n;
+        }();
+
+        // every WILL and DO we open with, so onConnect() is a single write.
+        constexpr std::array<uint8_t, handshake_size> handshake = [] {
+            using namespace codes;
+            std::array<uint8_t, handshake_size> out{};
+            std::size_t i = 0;
+            for(auto c : options::supported) {
+                if(options::flags[c] & options::StartWill) {
+                    out[i++] = IAC; out[i++] = WILL; out[i++] = c;
+                }
+                if(options::flags[c] & options::StartDo) {
+                    out[i++] = IAC; out[i++] = DO; out[i++] = c;
+                }
+            }
+            return out;
+        }();
+
+        // the most bulk text put in one write. a prompt queued behind it waits for at most this much.
+        constexpr std::size_t write_quantum = 16384;
+        // a shared buffer gets written from where it is, rather than copied, if at least this much of it goes at once.
+        constexpr std::size_t direct_min = 2048;
+        constexpr std::size_t unbounded = std::numeric_limits<std::size_t>::max();
+
+        // how much of a bulk send to take from offset when there's room for at most room bytes. prefers
+        // ending on a line, and never splits an escaped IAC pair.
+        std::size_t bulkCut(const std::vector<uint8_t> &data, std::size_t offset, std::size_t room) {
+            auto remaining = data.size() - offset;
+            if(remaining <= room) return remaining;
+            auto cut = room;
+            for(auto i = room; i > 0; i--) {
+                if(data[offset + i - 1] == '\n') {
+                    cut = i;
+                    break;
+                }
+            }
+            std::size_t iacs = 0;
+            while(iacs < cut && data[offset + cut - iacs - 1] == codes::IAC) iacs++;
+            if(iacs % 2) cut--;
+            return cut ? cut : std::min<std::size_t>(remaining, 2);
+        }
     }
 
     TelnetMessage::TelnetMessage(TelnetMsgType m_type) {
@@ -111,7 +163,7 @@ namespace ring::telnet {
             response.emplace(TelnetMsgType::AppData);
             auto check = std::find(begin, end, IAC);
             auto &vec = response.value().data;
-            std::copy(begin, check, std::back_inserter(vec));
+            vec.assign(begin, check);
             buf.consume(vec.size());
             return response;
         }
@@ -126,61 +178,33 @@ namespace ring::telnet {
     }
 
     bool TelnetOption::startDo() const {
-        using namespace codes;
-        switch(code) {
-            case NAWS:
-            case MTTS:
-                return true;
-            default:
-                return false;
-        }
+        return options::flags[code] & options::StartDo;
     }
 
     bool TelnetOption::supportLocal() const {
-        using namespace codes;
-        switch(code) {
-            //case MCCP2:
-            case MSSP:
-            case SGA:
-            case MSDP:
-            case GMCP:
-            //case MXP:
-                return true;
-            default:
-                return false;
-        }
+        return options::flags[code] & options::SupportLocal;
     }
 
     bool TelnetOption::supportRemote() const {
-        using namespace codes;
-        switch(code) {
-            case NAWS:
-            case MTTS:
-                return true;
-            default:
-                return false;
-        }
+        return options::flags[code] & options::SupportRemote;
     }
 
     bool TelnetOption::startWill() const {
+        return options::flags[code] & options::StartWill;
+    }
+
+    void TelnetOption::enableLocal() {
         using namespace codes;
         switch(code) {
-            //case MCCP2:
-            case MSSP:
-            case SGA:
-            case MSDP:
             case GMCP:
-            //case MXP:
-                return true;
-            default:
-                return false;
+                conn->details.gmcp = true;
+                break;
+            case MSDP:
+                conn->details.msdp = true;
+                break;
         }
     }
 
-    void TelnetOption::enableLocal() {
-
-    }
-
     void TelnetOption::enableRemote() {
         using namespace codes;
         switch(code) {
@@ -188,6 +212,9 @@ namespace ring::telnet {
                 conn->details.mtts = true;
                 conn->sendSub(code, std::vector<uint8_t>({1}));
                 break;
+            case NAWS:
+                conn->details.naws = true;
+                break;
         }
     }
 
@@ -277,9 +304,33 @@ namespace ring::telnet {
             case MTTS:
                 subMTTS(msg);
                 break;
+            case NAWS:
+                subNAWS(msg);
+                break;
+            case GMCP:
+                if(local.enabled) conn->handleGMCP(msg);
+                break;
         }
     }
 
+    void TelnetOption::subNAWS(const TelnetMessage &msg) {
+        // a 255 in the width or height arrives doubled, so undo that first.
+        uint8_t dims[4];
+        std::size_t count = 0;
+        for(std::size_t i = 0; i < msg.data.size() && count < 4; i++) {
+            dims[count++] = msg.data[i];
+            if(msg.data[i] == codes::IAC && i + 1 < msg.data.size() && msg.data[i + 1] == codes::IAC) i++;
+        }
+        if(count < 4) return;
+
+        auto &details = conn->details;
+        details.naws = true;
+        int width = (dims[0] << 8) | dims[1], height = (dims[2] << 8) | dims[3];
+        // zero means the client doesn't know, so keep what we had.
+        if(width) details.width = width;
+        if(height) details.height = height;
+    }
+
     void TelnetOption::subMTTS(const TelnetMessage &msg) {
         if(msg.data.empty()) return; // we need data to be useful.
         if(msg.data[0] != 0) return; // this is invalid MTTS.
@@ -287,8 +338,12 @@ namespace ring::telnet {
 
         std::string mtts = boost::algorithm::to_upper_copy(std::string(msg.data.begin(), msg.data.end()).substr(1));
 
-        if(mtts == mtts_last) // there is no more data to be gleaned from asking...
+        auto &mtts_last = conn->mtts_last;
+        auto &mtts_count = conn->mtts_count;
+        if(mtts == mtts_last) { // there is no more data to be gleaned from asking...
+            conn->mtts_done = true;
             return;
+        }
 
         switch(mtts_count) {
             case 0:
@@ -305,7 +360,10 @@ namespace ring::telnet {
         mtts_count++;
         // cache the results and request more info.
         mtts_last = mtts;
-        if(mtts_count >= 2) return; // there is no more info to request.
+        if(mtts_count >= 2) { // there is no more info to request.
+            conn->mtts_done = true;
+            return;
+        }
         conn->sendSub(code, std::vector<uint8_t>({1}));
 
     }
@@ -388,9 +446,12 @@ namespace ring::telnet {
             details.vt100 = true;
         }
 
-        // UTF8
+        // UTF8. a client that answers MTTS without it gets Latin-1, unless the game picked something else.
         if(v & 4) {
             details.utf8 = true;
+            details.charset = ring::net::Utf8;
+        } else if(details.charset == ring::net::Utf8) {
+            details.charset = ring::net::Latin1;
         }
 
         // XTERM256 colors
@@ -463,30 +524,52 @@ namespace ring::telnet {
 
 
     MudTelnetConnection::MudTelnetConnection(std::string &conn_id, boost::asio::io_context &con) : ring::net::MudConnection(conn_id, con),
-    start_timer(con, boost::asio::chrono::milliseconds(1000)), out_queue(100) {
-        using namespace codes;
+    // a lane is never full by count: a tick's worth of output can be any number of sends. bulk text is
+    // bounded in bytes instead, by manager.output_limit.
+    out_lanes{net::grow_queue<out_chunk>(unbounded), net::grow_queue<out_chunk>(unbounded), net::grow_queue<out_chunk>(unbounded)}, handlers(makeHandlers(this, std::make_index_sequence<options::supported.size()>())),
+    wheel(net::manager.wheelFor(conn_id)) {
+        throttle.configure(net::manager.throttle_limits);
+        word_wrap = net::manager.word_wrap;
+    }
 
-        for(const auto &code : {MSSP, SGA, MSDP, GMCP, NAWS, MTTS}) {
-            handlers.emplace(code, TelnetOption(this, code));
-        }
+    MudTelnetConnection::~MudTelnetConnection() {
+        wheel.cancel(wheel_entry);
     }
 
     MudTelnetConnection::MudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j) : MudTelnetConnection(conn_id, con) {}
 
+    std::size_t MudTelnetConnection::heapBytes() {
+        std::size_t lanes = 0;
+        for(auto &l : out_lanes) lanes += l.capacity() * sizeof(out_chunk);
+        return MudConnection::heapBytes() + lanes +
+               net::stringHeap(app_data) + net::stringHeap(mtts_last) + in_buffer.capacity() + out_buffer.capacity();
+    }
+
+    void MudTelnetConnection::bindWheel() {
+        // the wheel calls this after dropping its lock, so cancelling in the destructor can't stop one
+        // that's already on its way. it has to find out for itself whether the connection is still here.
+        std::weak_ptr<MudConnection> self = weak_from_this();
+        wheel_entry.callback = [self] {
+            auto conn = std::static_pointer_cast<MudTelnetConnection>(self.lock());
+            if(!conn) return;
+            conn->conn_strand.post(net::timed("wheel", [self] {
+                if(auto conn = self.lock()) std::static_pointer_cast<MudTelnetConnection>(conn)->onWheel();
+            }));
+        };
+    }
+
     void MudTelnetConnection::onConnect() {
-        using namespace codes;
+        bindWheel();
         for(auto &h : handlers) {
-            if(h.second.startWill()) {
-                h.second.local.negotiating = true;
-                sendNegotiate(WILL, h.first);
-            }
-            if(h.second.startDo()) {
-                h.second.remote.negotiating = true;
-                sendNegotiate(DO, h.first);
-            }
+            if(h.startWill()) h.local.negotiating = true;
+            if(h.startDo()) h.remote.negotiating = true;
         }
-        start_timer.expires_after(boost::asio::chrono::milliseconds(300));
-        start_timer.async_wait([&](auto ec){if(!ec) ready();});
+        sendBytes(std::vector<uint8_t>(handshake.begin(), handshake.end()), LaneInteractive);
+        touchInput();
+        touchOutput();
+        negotiate_deadline = net::wheel_clock::now() + net::manager.timeouts.negotiation;
+        proxy_deadline = net::wheel_clock::now() + net::manager.timeouts.proxy_header;
+        armWheel();
     }
 
     void MudTelnetConnection::start() {
@@ -494,12 +577,30 @@ namespace ring::telnet {
     }
 
     void MudTelnetConnection::ready() {
+        ready_sent = true;
         net::ConnectionMsg m;
         m.conn_id = conn_id;
         m.event = net::CONNECTED;
         net::manager.events.push(m);
     }
 
+    bool MudTelnetConnection::negotiated() const {
+        bool pending = false, heard = false;
+        for(const auto &h : handlers) {
+            pending |= h.local.negotiating || h.remote.negotiating;
+            heard |= h.local.answered || h.remote.answered;
+        }
+        // typing without having answered anything: not a telnet client, so there's nothing to wait for.
+        if(!heard) return typed;
+        if(pending) return false;
+        // each MTTS answer takes another round trip.
+        return !details.mtts || mtts_done;
+    }
+
+    void MudTelnetConnection::checkReady() {
+        if(!ready_sent && !expect_proxy && active && negotiated()) ready();
+    }
+
     void MudTelnetConnection::handleMessage(const TelnetMessage &msg) {
         switch(msg.msg_type) {
             case AppData:
@@ -518,13 +619,22 @@ namespace ring::telnet {
     }
 
     void MudTelnetConnection::handleAppData(const TelnetMessage &msg) {
+        if(!ready_sent) {
+            // the game has to hear about the connection before it hears from it.
+            typed = true;
+            checkReady();
+        }
         net::GameMsg g;
         for(const auto& c : msg.data) {
             switch(c) {
                 case '\n':
-                    g.command = app_data;
+                    // the game only ever sees valid UTF-8.
+                    g.command = text::toUtf8(app_data, details.charset);
                     app_data.clear();
-                    game_messages.push(g);
+                    throttle.countLine();
+                    // a line's here, so it's CONNECTED now whatever negotiation is still outstanding.
+                    if(!ready_sent) ready();
+                    queueInput(g);
                     break;
                 case '\r':
                     // we just ignore these.
@@ -536,15 +646,166 @@ namespace ring::telnet {
         }
     }
 
+    void MudTelnetConnection::queueInput(net::GameMsg &g) {
+        g.received = read_at;
+        g.queued = net::latency_clock::now();
+        bool queued;
+        if(auto portal = net::manager.portal.get()) {
+            queued = g.gmcp.empty() ? portal->input(conn_id, g.command) : portal->gmcp(conn_id, g.gmcp, g.gmcp_raw);
+        } else {
+            queued = game_messages.push(g);
+            if(queued) wake();
+        }
+        if(queued) net::latency.record(net::LatencyNetIn, g.queued - g.received);
+        else throttle.stats.lines_dropped++;
+    }
+
+    void MudTelnetConnection::handleGMCP(const TelnetMessage &msg) {
+        std::string_view package, payload;
+        net::splitGMCP(std::string_view(reinterpret_cast<const char*>(msg.data.data()), msg.data.size()), package, payload);
+        if(package.empty() || !net::manager.gmcp.wants(package)) return;
+        net::GameMsg g;
+        g.gmcp = package;
+        // json shouldn't have a 255 in it, but if it does it arrived doubled.
+        g.gmcp_raw.reserve(payload.size());
+        for(std::size_t i = 0; i < payload.size(); i++) {
+            g.gmcp_raw.push_back(payload[i]);
+            if(uint8_t(payload[i]) == codes::IAC && i + 1 < payload.size() && uint8_t(payload[i + 1]) == codes::IAC) i++;
+        }
+        queueInput(g);
+    }
+
     void MudTelnetConnection::handleCommand(const TelnetMessage &msg) {
 
     }
 
-    void MudTelnetConnection::resume() {}
+    void MudTelnetConnection::resume() {
+        // a recovered connection was already handed to the game before the copyover.
+        ready_sent = true;
+        bindWheel();
+        touchInput();
+        touchOutput();
+        // one still waiting on its PROXY header gets a fresh window, since the old one went with the old process.
+        proxy_deadline = net::wheel_clock::now() + net::manager.timeouts.proxy_header;
+        armWheel();
+    }
+
+    void MudTelnetConnection::touchInput() {
+        last_input = net::wheel_clock::now().time_since_epoch().count();
+    }
+
+    void MudTelnetConnection::touchOutput() {
+        last_output = net::wheel_clock::now().time_since_epoch().count();
+    }
+
+    void MudTelnetConnection::armWheel() {
+        using clock = net::wheel_clock;
+        auto &cfg = net::manager.timeouts;
+        auto now = clock::now();
+        auto next = clock::time_point::max();
+
+        // with a PROXY header still to come, the game hears about the connection once we know who it is.
+        if(expect_proxy) next = std::min(next, proxy_deadline);
+        else if(!ready_sent) next = std::min(next, negotiate_deadline);
+        if(cfg.idle.count()) next = std::min(next, clock::time_point(clock::duration(last_input.load())) + cfg.idle);
+        if(cfg.keepalive.count()) next = std::min(next, clock::time_point(clock::duration(last_output.load())) + cfg.keepalive);
+
+        if(next == clock::time_point::max()) return; // nothing to wait for.
+        wheel.arm(wheel_entry, std::max(next - now, clock::duration::zero()));
+    }
+
+    void MudTelnetConnection::onWheel() {
+        using clock = net::wheel_clock;
+        if(!active) return;
+        auto &cfg = net::manager.timeouts;
+        auto now = clock::now();
+
+        if(expect_proxy) {
+            if(now >= proxy_deadline) {
+                std::cerr << "No PROXY header from " << details.hostIp << " on " << conn_id << ", dropping it." << std::endl;
+                refuse();
+                return;
+            }
+        } else if(!ready_sent && now >= negotiate_deadline) ready();
+
+        if(cfg.idle.count() && now - clock::time_point(clock::duration(last_input.load())) >= cfg.idle) {
+            expire();
+            return;
+        }
+
+        if(cfg.keepalive.count() && now - clock::time_point(clock::duration(last_output.load())) >= cfg.keepalive) {
+            sendBytes({codes::IAC, codes::NOP}, LaneInteractive);
+        }
+        armWheel();
+    }
+
+    void MudTelnetConnection::expire() {
+        active = false;
+        net::ConnectionMsg m;
+        m.conn_id = conn_id;
+        m.event = net::TIMEOUT;
+        net::manager.events.push(m);
+        disconnect();
+    }
+
+    void MudTelnetConnection::refuse() {
+        active = false;
+        net::ConnectionMsg m;
+        m.conn_id = conn_id;
+        m.event = net::DISCONNECTED;
+        net::manager.events.push(m);
+        disconnect();
+    }
+
+    nlohmann::json output_stats::serialize() const {
+        return {
+                {"sends_dropped", sends_dropped.load()},
+                {"bytes_dropped", bytes_dropped.load()}
+        };
+    }
+
+    void MudTelnetConnection::queueChunk(out_chunk item, OutputLane lane) {
+        auto len = item.bytes().size();
+        bool queued;
+        if(lane != LaneBulk) {
+            // the priority lanes have no limit: losing a negotiation reply could leave the client waiting
+            // on it forever, and there are only ever a few of these at once.
+            item.mark = bulk_queued;
+            queued = out_lanes[lane].push(std::move(item));
+        } else {
+            // a client that stops reading can't make us hold the game's text forever. past the limit new bulk
+            // is dropped, though one send always fits when nothing is waiting, however big it is.
+            // the writer can take a send before it's counted as queued, so this can briefly come out behind.
+            uint64_t taken = bulk_taken, total = bulk_queued;
+            auto waiting = total > taken ? total - taken : 0;
+            queued = !(waiting && waiting + len > net::manager.output_limit) && out_lanes[lane].push(std::move(item));
+            // counted once it's in the lane, so the writer never waits on bulk that isn't there yet.
+            if(queued) bulk_queued += len;
+        }
+        if(queued) return;
+        net::manager.output.sends_dropped++;
+        net::manager.output.bytes_dropped += len;
+        if(!output_dropped.exchange(true)) {
+            std::cerr << "Output to " << conn_id << " is over the limit, dropping sends to it." << std::endl;
+        }
+    }
+
+    bool MudTelnetConnection::queued() {
+        for(auto &lane : out_lanes) {
+            if(!lane.empty()) return true;
+        }
+        return false;
+    }
+
+    TelnetOption* MudTelnetConnection::option(uint8_t code) {
+        auto slot = options::slots[code];
+        return slot == options::no_slot ? nullptr : &handlers[slot];
+    }
 
     void MudTelnetConnection::handleNegotiate(const TelnetMessage &msg) {
         using namespace codes;
-        if(!handlers.count(msg.codes[1])) {
+        auto hand = option(msg.codes[1]);
+        if(!hand) {
             switch(msg.codes[0]) {
                 case WILL:
                     sendNegotiate(DONT, msg.codes[1]);
@@ -557,73 +818,66 @@ namespace ring::telnet {
             }
             return;
         }
-        auto &hand = handlers.at(msg.codes[1]);
-        hand.receiveNegotiate(msg.codes[0]);
+        hand->receiveNegotiate(msg.codes[0]);
     }
 
     void MudTelnetConnection::handleSubnegotiate(const TelnetMessage &msg) {
-        if(handlers.count(msg.codes[0])) {
-            auto &hand = handlers.at(msg.codes[0]);
-            hand.subNegotiate(msg);
-        }
+        if(auto hand = option(msg.codes[0])) hand->subNegotiate(msg);
     }
 
     void MudTelnetConnection::sendNegotiate(uint8_t command, const uint8_t option) {
         std::vector<uint8_t> data = {codes::IAC, command, option};
-        sendBytes(data);
+        sendBytes(std::move(data), LaneInteractive);
+    }
+
+    void MudTelnetConnection::queueText(const std::string &txt, net::TextType mode, bool force_break) {
+        std::shared_ptr<const std::string> wrapped;
+        if(word_wrap && details.width > 0) wrapped = text::wrapCached(txt, details.width);
+        std::string encoded;
+        if(details.charset != net::Utf8) encoded = text::fromUtf8(wrapped ? *wrapped : txt, details.charset);
+        const auto &src = details.charset != net::Utf8 ? encoded : wrapped ? *wrapped : txt;
+        sendBytes(frameText(src, mode, details.telopt_eor, force_break), mode == net::Prompt ? LaneInteractive : LaneBulk);
     }
 
     void MudTelnetConnection::sendText(const std::string &txt, net::TextType mode) {
         if(txt.empty()) return;
-        std::vector<uint8_t> data;
-
-        // standardize outgoing linebreaks for telnet.
-        for(const auto &c : txt) {
-            switch(c) {
-                case '\r':
-                    break;
-                case '\n':
-                    data.push_back('\r');
-                    data.push_back('\n');
-                    break;
-                default:
-                    data.push_back(c);
-                    break;
-            }
-        }
-
-        if(mode == net::Line && !boost::algorithm::ends_with(txt, "\n")) {
-            data.push_back('\r');
-            data.push_back('\n');
-        }
-
-        if(mode == net::Prompt) {
-            data.push_back(codes::IAC);
-            if(details.telopt_eor) data.push_back(codes::EOR); else data.push_back(codes::GA);
-        }
-        sendBytes(data);
+        queueText(txt, mode);
     }
 
     void MudTelnetConnection::sendLine(const std::string &txt) {
-        sendText(txt + "\n", net::Line);
+        queueText(txt, net::Line, true);
     }
 
     void MudTelnetConnection::sendPrompt(const std::string &txt) {
-        sendText(txt, net::Prompt);
+        if(txt.empty()) return;
+        queueText(txt, net::Prompt);
+    }
+
+    void MudTelnetConnection::sendShared(std::shared_ptr<const std::vector<uint8_t>> data, OutputLane lane) {
+        sendBytes(*data, lane);
     }
 
-    void MudTelnetConnection::sendSub(const uint8_t op, const std::vector<uint8_t> &data) {
+    void MudTelnetConnection::sendAsset(const std::shared_ptr<const net::static_asset> &asset) {
+        // the wire form is UTF-8 and unwrapped. anyone who needs it otherwise gets it the long way.
+        if(!asset || details.charset != net::Utf8 || (word_wrap && details.width > 0)) return MudConnection::sendAsset(asset);
+        auto &wire = asset->wire[details.renderColor()];
+        if(!wire->empty()) sendShared(wire);
+    }
+
+    void MudTelnetConnection::sendSub(const uint8_t op, const std::vector<uint8_t> &data, OutputLane lane) {
         using namespace codes;
         std::vector<uint8_t> out({IAC, SB, op});
         std::copy(data.begin(), data.end(), std::back_inserter(out));
         out.push_back(IAC);
         out.push_back(SE);
-        sendBytes(out);
+        sendBytes(std::move(out), lane);
     }
 
     nlohmann::json MudTelnetConnection::serialize() {
         auto j = MudConnection::serialize();
         j["app_data"] = app_data;
+        j["word_wrap"] = word_wrap;
+        if(expect_proxy) j["expect_proxy"] = true;
         j["handlers"] = serializeHandlers();
         return j;
     }
@@ -631,7 +885,7 @@ namespace ring::telnet {
     nlohmann::json MudTelnetConnection::serializeHandlers() {
         nlohmann::json j;
         for(const auto& h : handlers) {
-            j.push_back(std::tuple(h.first, h.second.serialize()));
+            j.push_back(std::tuple(h.code, h.serialize()));
         }
         return j;
     }
@@ -639,33 +893,57 @@ namespace ring::telnet {
     void MudTelnetConnection::loadJson(nlohmann::json &j) {
         MudConnection::loadJson(j);
         if(j.contains("app_data")) app_data = j["app_data"];
+        if(j.contains("word_wrap")) word_wrap = j["word_wrap"];
+        if(j.contains("expect_proxy")) expect_proxy = j["expect_proxy"];
         if(j.contains("handlers")) for(auto &j2 : j["handlers"]) {
             uint8_t id = j2[0];
-            auto handler = handlers.find(id);
-            if(handler != handlers.end()) {
-                handler->second.load(j2[1]);
-            }
+            if(auto handler = option(id)) handler->load(j2[1]);
         }
     }
 
     void MudTelnetConnection::onDataReceived() {
+        touchInput();
         while(auto msg = parse_message(in_buffer)) {
             handleMessage(msg.value());
         }
+        checkReady();
+    }
+
+    void MudTelnetConnection::feed(const uint8_t *data, std::size_t len) {
+        read_at = net::latency_clock::now();
+        auto prep = in_buffer.prepare(len);
+        memcpy(prep.data(), data, len);
+        in_buffer.commit(len);
+        onDataReceived();
     }
 
     void MudTelnetConnection::sendJson(const nlohmann::json &j) {
 
     }
 
+    void MudTelnetConnection::sendGMCP(const std::string &package, const nlohmann::json &data) {
+        if(!details.gmcp) return;
+        std::vector<uint8_t> body(package.begin(), package.end());
+        if(!data.is_null()) {
+            // json is always valid UTF-8, so there's no IAC in it to escape.
+            auto dumped = data.dump();
+            body.push_back(' ');
+            body.insert(body.end(), dumped.begin(), dumped.end());
+        }
+        sendSub(codes::GMCP, body, LaneOOB);
+    }
+
     void MudTelnetConnection::sendMSSP(const std::vector<std::tuple<std::string, std::string>> &data) {
 
     }
 
     TcpMudTelnetConnection::TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con) : MudTelnetConnection(conn_id, con), _socket(con) {}
 
+    TcpMudTelnetConnection::TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, boost::asio::generic::stream_protocol prot,
+                                                   int socket) : MudTelnetConnection(conn_id, con), _socket(con, prot, socket) {}
+
     TcpMudTelnetConnection::TcpMudTelnetConnection(std::string &conn_id, boost::asio::io_context &con, nlohmann::json &j,
-                                                   boost::asio::ip::tcp prot, int socket) : MudTelnetConnection(conn_id, con, j), _socket(con, prot, socket) {
+                                                   boost::asio::generic::stream_protocol prot, int socket) : MudTelnetConnection(conn_id, con, j), _socket(con, prot, socket) {
         MudTelnetConnection::loadJson(j);
 
         if(j.contains("in_buffer")) {
@@ -685,105 +963,404 @@ namespace ring::telnet {
         }
     }
 
+    TcpMudTelnetConnection::~TcpMudTelnetConnection() {
+        detachUring();
+        if(admitted) net::manager.admission.release(peer);
+    }
+
     nlohmann::json TcpMudTelnetConnection::serialize() {
         using base64 = cppcodec::base64_rfc4648;
         flush_out_queue();
         auto j = MudTelnetConnection::serialize();
         j["socket"] = _socket.native_handle();
-        j["protocol"] = _socket.local_endpoint().protocol() == boost::asio::ip::tcp::v4() ? 4 : 6;
+        j["protocol"] = net::familyCode(_socket.local_endpoint().protocol().family());
         if(in_buffer.size()) j["in_buffer"] = base64::encode((uint8_t*)in_buffer.data().data(), in_buffer.data().size());
         if(out_buffer.size()) j["out_buffer"] = base64::encode((uint8_t*)out_buffer.data().data(), out_buffer.data().size());
         return j;
     }
 
+    std::size_t TcpMudTelnetConnection::memoryFootprint() {
+        return sizeof(*this) + heapBytes() + (throttle_timer ? sizeof(boost::asio::steady_timer) : 0);
+    }
+
     void TcpMudTelnetConnection::start() {
-        conn_strand.post([this] { read(); });
+        boost::system::error_code ec;
+        _socket.non_blocking(true, ec);
+        if(auto uring = net::manager.uring.get()) uring->attach(*this);
+        conn_strand.post(net::timed("start read", [this] { read(); }));
         MudTelnetConnection::start();
-        conn_strand.post([this] { write(); });
+        conn_strand.post(net::timed("start write", [this] { write(); }));
     }
 
     void TcpMudTelnetConnection::resume() {
-        conn_strand.post([this] { read(); });
-        conn_strand.post([this] { write(); });
+        boost::system::error_code ec;
+        _socket.non_blocking(true, ec);
+        if(auto uring = net::manager.uring.get()) uring->attach(*this);
+        MudTelnetConnection::resume();
+        conn_strand.post(net::timed("start read", [this] { read(); }));
+        conn_strand.post(net::timed("start write", [this] { write(); }));
     }
 
-    void TcpMudTelnetConnection::do_read(boost::system::error_code ec, std::size_t trans) {
-        if(ec) {
+    void TcpMudTelnetConnection::onReadError(boost::system::error_code ec) {
+        // if we closed it ourselves, the game already heard about it.
+        if(!active) return;
+        active = false;
+        net::ConnectionMsg m;
+        m.conn_id = conn_id;
+        m.event = net::DISCONNECTED;
+        net::manager.events.push(m);
+        _socket.cancel(ec);
+        wake();
+    }
+
+    bool TcpMudTelnetConnection::consume(std::size_t trans) {
+        net::lag_scope scope("telnet read");
+        read_at = net::latency_clock::now();
+        in_buffer.commit(trans);
+        throttle.countBytes(trans);
+        if(expect_proxy) {
+            // a refused header leaves us inactive. an incomplete one just needs more bytes.
+            if(!readProxyHeader()) return active;
+            // the header isn't part of the telnet stream, so it stays out of the capture.
+            trans = in_buffer.size();
+        }
+        if(net::manager.capture.active()) {
+            auto box = in_buffer.data();
+            capture(net::CaptureIn, static_cast<const uint8_t*>(box.data()) + box.size() - trans, trans);
+        }
+        onDataReceived();
+        return true;
+    }
+
+    void TcpMudTelnetConnection::capture(net::CaptureKind kind, const uint8_t *data, std::size_t len) {
+        auto &cap = net::manager.capture;
+        if(!capture_id) {
+            capture_id = cap.nextConnection();
+            cap.record(capture_id, net::CaptureOpen, reinterpret_cast<const uint8_t*>(conn_id.data()), conn_id.size());
+        }
+        cap.record(capture_id, kind, data, len);
+    }
+
+    bool TcpMudTelnetConnection::readProxyHeader() {
+        auto box = in_buffer.data();
+        net::proxy_header header;
+        switch(net::parseProxyHeader(static_cast<const uint8_t*>(box.data()), box.size(), header)) {
+            case net::ProxyIncomplete:
+                return false;
+            case net::ProxyInvalid:
+                std::cerr << "Bad PROXY header on " << conn_id << " from " << details.hostIp << ", dropping it." << std::endl;
+                refuse();
+                return false;
+            case net::ProxyDone:
+                break;
+        }
+        in_buffer.consume(header.length);
+        expect_proxy = false;
+        if(!header.local) {
+            // the address we saw at accept time was the proxy's. admission applies to the real one.
+            if(!net::manager.admission.admit(header.source, net::manager.admission_limits)) {
+                refuse();
+                return false;
+            }
+            peer = header.source;
+            admitted = true;
+            details.proxy = true;
+            details.hostIp = header.source.to_string();
+            if(net::manager.resolve_hostnames) net::manager.lookupHost(conn_id, header.source);
+        }
+        // if negotiation has already run out, this gets CONNECTED out straight away.
+        armWheel();
+        return true;
+    }
+
+    net::throttle_clock::duration TcpMudTelnetConnection::readDelay() {
+        auto wait = throttle.delay();
+        // a full game queue means the game isn't keeping up. stop reading until it does.
+        if(!game_messages.write_available()) wait = std::max<net::throttle_clock::duration>(wait, std::chrono::milliseconds(50));
+        if(wait.count() <= 0) {
+            throttle.leaveThrottle();
+        } else if(throttle.enterThrottle()) {
             net::ConnectionMsg m;
             m.conn_id = conn_id;
-            m.event = net::DISCONNECTED;
+            m.event = net::THROTTLED;
             net::manager.events.push(m);
-            _socket.cancel();
-        } else {
-            // all is well, we got some data.
-            in_buffer.commit(trans);
-            onDataReceived();
-            auto prep = in_buffer.prepare(1024);
-
-            _socket.async_read_some(boost::asio::buffer(prep), [this](auto ec, std::size_t trans) { do_read(ec, trans); });
         }
+        return wait;
+    }
+
+    void TcpMudTelnetConnection::continueRead() {
+        auto wait = readDelay();
+        if(wait.count() > 0) throttleRead(wait);
+        else read();
+    }
+
+    void TcpMudTelnetConnection::throttleRead(net::throttle_clock::duration wait) {
+        // a multishot recv keeps going on its own, so it has to be called off.
+        if(recv_armed) net::manager.uring->cancel(*this, net::UringRecv);
+        if(!throttle_timer) throttle_timer = std::make_unique<boost::asio::steady_timer>(_socket.get_executor());
+        throttle_timer->expires_after(wait);
+        throttle_timer->async_wait(net::recycled([this](auto ec) { if(!ec) continueRead(); }));
     }
 
     void TcpMudTelnetConnection::read() {
-        auto prep = in_buffer.prepare(1024);
-        _socket.async_read_some(boost::asio::buffer(prep), [this](auto ec, std::size_t trans) { do_read(ec, trans); });
+        if(auto uring = net::manager.uring.get()) {
+            // does nothing if the multishot recv is still running. if the ring is too busy to take it, try again shortly.
+            if(!uring->recv(*this, _socket.native_handle())) throttleRead(std::chrono::milliseconds(10));
+            return;
+        }
+        boost::asio::co_spawn(_socket.get_executor(), readLoop(), boost::asio::detached);
+    }
+
+    boost::asio::awaitable<void> TcpMudTelnetConnection::readLoop() {
+        boost::system::error_code ec;
+        while(true) {
+            if(auto wait = readDelay(); wait.count() > 0) {
+                // we simply don't read from the socket for a while, so the kernel pushes back on the client.
+                if(!throttle_timer) throttle_timer = std::make_unique<boost::asio::steady_timer>(_socket.get_executor());
+                throttle_timer->expires_after(wait);
+                co_await throttle_timer->async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+                if(ec) co_return;
+                continue;
+            }
+            // wait for the socket to have something before reading, so an idle connection holds no read buffer.
+            co_await _socket.async_wait(boost::asio::socket_base::wait_read, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            // borrowed by whichever connection this thread is reading for. only what arrived gets kept.
+            thread_local std::array<uint8_t, 4096> scratch;
+            std::size_t trans = 0;
+            if(!ec) trans = _socket.read_some(boost::asio::buffer(scratch), ec);
+            if(ec == boost::asio::error::would_block || ec == boost::asio::error::try_again) continue;
+            if(ec) {
+                onReadError(ec);
+                co_return;
+            }
+            auto prep = in_buffer.prepare(trans);
+            memcpy(prep.data(), scratch.data(), trans);
+            if(!consume(trans)) co_return;
+        }
+    }
+
+    void TcpMudTelnetConnection::received(const uint8_t *data, std::size_t len) {
+        auto prep = in_buffer.prepare(len);
+        memcpy(prep.data(), data, len);
+        if(consume(len)) continueRead();
     }
 
 
     void TcpMudTelnetConnection::do_write(boost::system::error_code ec, std::size_t trans) {
-        if(trans) out_buffer.consume(trans);
+        net::lag_scope scope("telnet write");
+        if(trans && net::manager.capture.active()) capture(net::CaptureOut, writing(), trans);
+        if(direct) {
+            bulk_offset += trans;
+            bulk_taken += trans;
+            direct = 0;
+        } else if(trans) {
+            out_buffer.consume(trans);
+        }
 
         if(ec) {
-            _socket.cancel();
+            _socket.cancel(ec);
             return;
             }
         else {
 
-            if(out_buffer.size())
-                _socket.async_write_some(out_buffer.data(), [this](auto ec, std::size_t trans) { do_write(ec, trans); });
+            if(out_buffer.size() || fillOutput(write_quantum, true))
+                writeSome();
             else {
                 out_mutex.unlock();
-                if(out_queue.empty()) {
-                    isWriting = false;
-                } else {
-                    flush_out_queue();
-                    _socket.async_write_some(out_buffer.data(), [this](auto ec, std::size_t trans) { do_write(ec, trans); });
+                isWriting = false;
+                // something may have been queued since the last flush. take it, unless a new writer already has.
+                if(queued() && !isWriting.exchange(true)) real_write();
+                else {
+                    noteFlushed();
+                    wake();
                 }
-
             }
         }
     }
 
     void TcpMudTelnetConnection::flush_out_queue() {
-        std::vector<uint8_t> out_data;
-        while(out_queue.pop(out_data)) {
-            auto prep = out_buffer.prepare(out_data.size());
-            memcpy(prep.data(), out_data.data(), out_data.size());
-            out_buffer.commit(out_data.size());
+        // a direct write that never completed goes again from where it started.
+        direct = 0;
+        fillOutput(std::numeric_limits<std::size_t>::max(), false);
+    }
+
+    bool TcpMudTelnetConnection::takeBulk(std::size_t want, bool allow_direct) {
+        while(want) {
+            if(bulk_offset >= bulk_rest.bytes().size()) {
+                bulk_offset = 0;
+                bulk_rest = {};
+                if(!out_lanes[LaneBulk].pop(bulk_rest)) break;
+            }
+            auto &bytes = bulk_rest.bytes();
+            auto take = bulkCut(bytes, bulk_offset, want);
+            if(allow_direct && bulk_rest.shared && out_buffer.size() == 0 && take >= direct_min) {
+                // nothing ahead of it, so write this part straight from the shared buffer. do_write moves bulk_offset.
+                direct = take;
+                return true;
+            }
+            auto prep = out_buffer.prepare(take);
+            memcpy(prep.data(), bytes.data() + bulk_offset, take);
+            out_buffer.commit(take);
+            bulk_offset += take;
+            bulk_taken += take;
+            want -= std::min(want, take);
+        }
+        return false;
+    }
+
+    bool TcpMudTelnetConnection::fillOutput(std::size_t budget, bool allow_direct) {
+        auto before = out_buffer.size();
+        uint64_t start = bulk_taken;
+        auto room = [&]() { return budget - std::min<uint64_t>(budget, bulk_taken - start); };
+        while(true) {
+            for(auto lane : {LaneInteractive, LaneOOB}) {
+                out_chunk item;
+                if(!held[lane] && out_lanes[lane].pop(item)) held[lane] = std::move(item);
+            }
+            // the one that was queued behind the least bulk. ties go to the interactive lane.
+            opt_type<out_chunk> *next = nullptr;
+            for(auto &h : held) {
+                if(h && (!next || h->mark < (*next)->mark)) next = &h;
+            }
+            if(!next) {
+                if(takeBulk(room(), allow_direct)) return true;
+                break;
+            }
+            // everything queued before it goes first if it fits in this write. if it doesn't, this write's
+            // worth does, and the rest waits behind it. no direct write then, or it would never get past.
+            auto ahead = (*next)->mark - std::min((*next)->mark, bulk_taken.load());
+            if(takeBulk(std::min<uint64_t>(ahead, room()), allow_direct && ahead <= room())) return true;
+            auto &bytes = (*next)->bytes();
+            auto prep = out_buffer.prepare(bytes.size());
+            memcpy(prep.data(), bytes.data(), bytes.size());
+            out_buffer.commit(bytes.size());
+            next->reset();
+        }
+        if(bulk_offset >= bulk_rest.bytes().size()) {
+            // don't hold on to a big send's buffer once it's all out.
+            bulk_rest = {};
+            bulk_offset = 0;
         }
+        return out_buffer.size() > before;
+    }
+
+    const uint8_t *TcpMudTelnetConnection::writing() {
+        if(direct) return bulk_rest.bytes().data() + bulk_offset;
+        return static_cast<const uint8_t*>(out_buffer.data().data());
     }
 
     void TcpMudTelnetConnection::real_write() {
         out_mutex.lock();
-        flush_out_queue();
-        _socket.async_write_some(out_buffer.data(), [this](auto ec, std::size_t trans) { do_write(ec, trans); });
+        fillOutput(write_quantum, true);
+        writeSome();
     }
 
-    void TcpMudTelnetConnection::sendBytes(const std::vector<uint8_t> &data) {
-        out_queue.push(data);
-        write();
+    void TcpMudTelnetConnection::writeSome() {
+        // the ring takes its own copy of out_buffer, or a share of bulk_rest's buffer: the kernel may read
+        // them after the connection has closed, or a copyover has moved out_buffer.
+        auto len = direct ? direct : out_buffer.size();
+        if(auto uring = net::manager.uring.get()) {
+            if(!uring->send(*this, _socket.native_handle(), writing(), len, direct ? bulk_rest.shared : nullptr))
+                do_write(boost::asio::error::no_buffer_space, 0);
+            return;
+        }
+        _socket.async_write_some(boost::asio::buffer(writing(), len), net::recycled([this](auto ec, std::size_t trans) { do_write(ec, trans); }));
     }
 
-    void TcpMudTelnetConnection::write() {
-        if(!isWriting) {
-            if(!out_queue.empty()) {
-                isWriting = true;
-                conn_strand.post([this]{ real_write(); });
+    bool TcpMudTelnetConnection::flushed() {
+        return !isWriting && !queued();
+    }
+
+    void TcpMudTelnetConnection::onUringRecv(int res, const uint8_t *data, std::size_t len, bool more) {
+        if(res > 0) {
+            // the ring wants its buffer back as soon as this returns.
+            std::lock_guard<std::mutex> guard(uring_in_mutex);
+            uring_in.insert(uring_in.end(), data, data + len);
+            if(uring_in_posted) return;
+            uring_in_posted = true;
+        }
+        std::weak_ptr<MudConnection> self = weak_from_this();
+        conn_strand.post(net::timed("telnet read", [self, res, more] {
+            if(auto conn = self.lock()) std::static_pointer_cast<TcpMudTelnetConnection>(conn)->uringReceived(res, more);
+        }));
+    }
+
+    void TcpMudTelnetConnection::uringReceived(int res, bool more) {
+        if(res > 0) {
+            {
+                std::lock_guard<std::mutex> guard(uring_in_mutex);
+                uring_in.swap(uring_taking);
+                uring_in_posted = false;
             }
+            if(!uring_taking.empty()) received(uring_taking.data(), uring_taking.size());
+            uring_taking.clear();
+        } else if(res == -ENOBUFS) {
+            // every provided buffer was in use. they're back by the time this resubmits.
+            continueRead();
+        } else if(res == -ECANCELED) {
+            // throttled. if the throttle already lifted while the cancel was in flight, pick reading back up.
+            if(active && !throttle.throttled && !more) continueRead();
+        } else {
+            onReadError(res ? boost::system::error_code(-res, boost::system::system_category()) : boost::asio::error::eof);
+        }
+    }
+
+    void TcpMudTelnetConnection::onUringSend(int res) {
+        std::weak_ptr<MudConnection> self = weak_from_this();
+        conn_strand.post(net::timed("telnet write", [self, res] {
+            auto conn = std::static_pointer_cast<TcpMudTelnetConnection>(self.lock());
+            if(!conn) return;
+            if(res < 0) conn->do_write(boost::system::error_code(-res, boost::system::system_category()), 0);
+            else conn->do_write({}, res);
+        }));
+    }
+
+    void TcpMudTelnetConnection::detachUring() {
+        if(auto uring = net::manager.uring.get()) {
+            if(recv_armed) uring->cancel(*this, net::UringRecv);
+            uring->detach(*this);
         }
     }
 
+    void TcpMudTelnetConnection::sendBytes(std::vector<uint8_t> data, OutputLane lane) {
+        touchOutput();
+        noteOutput();
+        queueChunk(std::move(data), lane);
+        if(!net::hold_output) write();
+    }
+
+    void TcpMudTelnetConnection::sendShared(std::shared_ptr<const std::vector<uint8_t>> data, OutputLane lane) {
+        touchOutput();
+        noteOutput();
+        queueChunk(std::move(data), lane);
+        if(!net::hold_output) write();
+    }
+
+    void TcpMudTelnetConnection::releaseOutput() {
+        write();
+    }
+
+    void TcpMudTelnetConnection::write() {
+        if(!queued() || isWriting.exchange(true)) return;
+        conn_strand.post(net::timed("write", [this]{ real_write(); }));
+    }
+
     void TcpMudTelnetConnection::onClose() {
-        _socket.cancel();
+        if(throttle_timer) throttle_timer->cancel();
+        wheel.cancel(wheel_entry);
+        detachUring();
+        // the socket may already be closed by disconnect().
+        boost::system::error_code ec;
+        _socket.cancel(ec);
+        wake();
+    }
+
+    void TcpMudTelnetConnection::disconnect() {
+        if(throttle_timer) throttle_timer->cancel();
+        detachUring();
+        boost::system::error_code ec;
+        _socket.shutdown(boost::asio::socket_base::shutdown_both, ec);
+        _socket.close(ec);
+        wake();
     }
 }
\ No newline at end of file
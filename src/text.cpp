@@ -0,0 +1,267 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/text.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ring::text {
+
+    namespace {
+
+        struct wrap_key {
+            std::string_view text;
+            std::size_t width;
+            bool operator==(const wrap_key &other) const {
+                return width == other.width && text == other.text;
+            }
+        };
+
+        struct wrap_key_hash {
+            std::size_t operator()(const wrap_key &k) const {
+                return std::hash<std::string_view>()(k.text) ^ (k.width * 0x9E3779B97F4A7C15ULL);
+            }
+        };
+
+        // anything shorter than this is cheaper to just wrap again.
+        constexpr std::size_t cache_min_size = 256;
+
+        class wrap_cache {
+        public:
+            explicit wrap_cache(std::size_t cap) : capacity(cap) {}
+
+            std::shared_ptr<const std::string> get(const std::string &s, std::size_t width) {
+                std::lock_guard<std::mutex> guard(cache_mutex);
+                auto found = index.find({s, width});
+                if(found == index.end()) return nullptr;
+                order.splice(order.begin(), order, found->second);
+                return found->second->wrapped;
+            }
+
+            void put(const std::string &s, std::size_t width, std::shared_ptr<const std::string> wrapped) {
+                std::lock_guard<std::mutex> guard(cache_mutex);
+                if(index.count({s, width})) return;
+                order.push_front({s, width, std::move(wrapped)});
+                index.emplace(wrap_key{order.front().text, width}, order.begin());
+                if(order.size() > capacity) {
+                    auto &last = order.back();
+                    index.erase({last.text, last.width});
+                    order.pop_back();
+                }
+            }
+
+        protected:
+            struct entry {
+                std::string text;
+                std::size_t width;
+                std::shared_ptr<const std::string> wrapped;
+            };
+            std::size_t capacity;
+            std::mutex cache_mutex;
+            std::list<entry> order;
+            std::unordered_map<wrap_key, std::list<entry>::iterator, wrap_key_hash> index;
+        };
+
+        wrap_cache cache(512);
+
+        void appendHardBroken(std::string &out, std::string_view word, std::size_t width, std::size_t &col) {
+            std::size_t i = 0;
+            while(i < word.size()) {
+                if(word[i] == '\x1b') {
+                    auto len = escapeLength(word, i);
+                    out.append(word.substr(i, len));
+                    i += len;
+                    continue;
+                }
+                auto start = i;
+                auto w = codepointWidth(decodeUtf8(word, i));
+                if(col && col + w > width) {
+                    out.push_back('\n');
+                    col = 0;
+                }
+                out.append(word.substr(start, i - start));
+                col += w;
+            }
+        }
+
+        void wrapLine(std::string &out, std::string_view line, std::size_t width) {
+            if(displayWidth(line) <= width) {
+                out.append(line);
+                return;
+            }
+            std::size_t col = 0, pending = 0, i = 0;
+            while(i < line.size()) {
+                if(line[i] == ' ') {
+                    pending++;
+                    i++;
+                    continue;
+                }
+                auto end = line.find(' ', i);
+                if(end == std::string_view::npos) end = line.size();
+                auto word = line.substr(i, end - i);
+                auto w = displayWidth(word);
+                i = end;
+
+                if(col + pending + w <= width) {
+                    out.append(pending, ' ');
+                    col += pending + w;
+                    out.append(word);
+                } else if(w <= width) {
+                    out.push_back('\n');
+                    out.append(word);
+                    col = w;
+                } else {
+                    if(col + pending < width) {
+                        out.append(pending, ' ');
+                        col += pending;
+                    }
+                    appendHardBroken(out, word, width, col);
+                }
+                pending = 0;
+            }
+            // trailing spaces matter for prompts, keep them if they fit.
+            if(pending && col + pending <= width) out.append(pending, ' ');
+        }
+    }
+
+    std::size_t asciiRun(const char *data, std::size_t length) {
+        std::size_t i = 0;
+#if defined(__SSE2__)
+        const __m128i space = _mm_set1_epi8(0x20), del = _mm_set1_epi8(0x7F);
+        for(; i + 16 <= length; i += 16) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            // signed compare, so bytes with the high bit set count as below space too.
+            int mask = _mm_movemask_epi8(_mm_cmplt_epi8(v, space)) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, del));
+            if(mask) return i + __builtin_ctz(mask);
+        }
+#endif
+        for(; i < length; i++) {
+            auto c = static_cast<uint8_t>(data[i]);
+            if(c < 0x20 || c >= 0x7F) return i;
+        }
+        return length;
+    }
+
+    std::size_t escapeLength(std::string_view s, std::size_t pos) {
+        if(pos + 1 >= s.size()) return s.size() - pos;
+        auto i = pos + 1;
+        if(s[i] == '[') {
+            // CSI: parameters and intermediates, then a final byte in 0x40-0x7E.
+            for(i++; i < s.size(); i++) {
+                auto c = static_cast<uint8_t>(s[i]);
+                if(c >= 0x40 && c <= 0x7E) return i - pos + 1;
+            }
+            return s.size() - pos;
+        }
+        if(s[i] == ']') {
+            // OSC: runs until BEL or ESC backslash.
+            for(i++; i < s.size(); i++) {
+                if(s[i] == '\a') return i - pos + 1;
+                if(s[i] == '\x1b' && i + 1 < s.size() && s[i + 1] == '\\') return i - pos + 2;
+            }
+            return s.size() - pos;
+        }
+        return 2;
+    }
+
+    char32_t decodeUtf8(std::string_view s, std::size_t &pos) {
+        auto c = static_cast<uint8_t>(s[pos]);
+        if(c < 0x80) {
+            pos++;
+            return c;
+        }
+        int extra;
+        char32_t cp;
+        if((c & 0xE0) == 0xC0) {
+            extra = 1;
+            cp = c & 0x1F;
+        } else if((c & 0xF0) == 0xE0) {
+            extra = 2;
+            cp = c & 0x0F;
+        } else if((c & 0xF8) == 0xF0) {
+            extra = 3;
+            cp = c & 0x07;
+        } else {
+            pos++;
+            return 0xFFFD;
+        }
+        if(pos + extra >= s.size()) {
+            pos++;
+            return 0xFFFD;
+        }
+        for(int i = 1; i <= extra; i++) {
+            auto cc = static_cast<uint8_t>(s[pos + i]);
+            if((cc & 0xC0) != 0x80) {
+                pos++;
+                return 0xFFFD;
+            }
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        pos += extra + 1;
+        return cp;
+    }
+
+    int codepointWidth(char32_t c) {
+        if(c < 0x20 || (c >= 0x7F && c < 0xA0)) return 0;
+        if(c < 0x300) return 1;
+        // combining marks and zero width characters.
+        if((c >= 0x300 && c <= 0x36F) || (c >= 0x200B && c <= 0x200F) || (c >= 0x20D0 && c <= 0x20FF) ||
+           (c >= 0xFE00 && c <= 0xFE0F) || (c >= 0xFE20 && c <= 0xFE2F)) return 0;
+        // east asian wide and fullwidth, plus the common emoji blocks.
+        if((c >= 0x1100 && c <= 0x115F) || (c >= 0x2E80 && c <= 0x303E) || (c >= 0x3041 && c <= 0x33FF) ||
+           (c >= 0x3400 && c <= 0x4DBF) || (c >= 0x4E00 && c <= 0x9FFF) || (c >= 0xA000 && c <= 0xA4CF) ||
+           (c >= 0xAC00 && c <= 0xD7A3) || (c >= 0xF900 && c <= 0xFAFF) || (c >= 0xFE30 && c <= 0xFE4F) ||
+           (c >= 0xFF00 && c <= 0xFF60) || (c >= 0xFFE0 && c <= 0xFFE6) || (c >= 0x1F300 && c <= 0x1F64F) ||
+           (c >= 0x1F900 && c <= 0x1F9FF) || (c >= 0x20000 && c <= 0x3FFFD)) return 2;
+        return 1;
+    }
+
+    std::size_t displayWidth(std::string_view s) {
+        std::size_t width = 0, i = 0;
+        while(i < s.size()) {
+            auto run = asciiRun(s.data() + i, s.size() - i);
+            width += run;
+            i += run;
+            if(i >= s.size()) break;
+            auto c = static_cast<uint8_t>(s[i]);
+            if(c == 0x1B) {
+                i += escapeLength(s, i);
+            } else if(c < 0x80) {
+                i++;
+            } else {
+                width += codepointWidth(decodeUtf8(s, i));
+            }
+        }
+        return width;
+    }
+
+    std::string wrap(std::string_view s, std::size_t width) {
+        std::string out;
+        if(!width) return std::string(s);
+        out.reserve(s.size() + s.size() / width + 1);
+        std::size_t start = 0;
+        while(start <= s.size()) {
+            auto end = s.find('\n', start);
+            if(end == std::string_view::npos) {
+                wrapLine(out, s.substr(start), width);
+                break;
+            }
+            wrapLine(out, s.substr(start, end - start), width);
+            out.push_back('\n');
+            start = end + 1;
+        }
+        return out;
+    }
+
+    std::shared_ptr<const std::string> wrapCached(const std::string &s, std::size_t width) {
+        if(s.size() < cache_min_size) return std::make_shared<const std::string>(wrap(s, width));
+        if(auto found = cache.get(s, width)) return found;
+        auto wrapped = std::make_shared<const std::string>(wrap(s, width));
+        cache.put(s, width, wrapped);
+        return wrapped;
+    }
+
+}
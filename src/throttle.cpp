@@ -0,0 +1,100 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/throttle.h"
+
+namespace ring::net {
+
+    void token_bucket::configure(double r, double b, throttle_clock::time_point now) {
+        rate = r;
+        burst = std::max(b, r);
+        tokens = burst;
+        last = now;
+    }
+
+    bool token_bucket::limited() const {
+        return rate > 0.0;
+    }
+
+    void token_bucket::refill(throttle_clock::time_point now) {
+        if(!limited()) return;
+        std::chrono::duration<double> elapsed = now - last;
+        last = now;
+        tokens = std::min(burst, tokens + elapsed.count() * rate);
+    }
+
+    void token_bucket::consume(double amount) {
+        if(limited()) tokens -= amount;
+    }
+
+    bool token_bucket::tryConsume(double amount) {
+        if(!limited()) return true;
+        if(tokens < amount) return false;
+        tokens -= amount;
+        return true;
+    }
+
+    bool token_bucket::full() const {
+        return !limited() || tokens >= burst;
+    }
+
+    bool token_bucket::exhausted() const {
+        return limited() && tokens < 0.0;
+    }
+
+    throttle_clock::duration token_bucket::waitTime() const {
+        if(!exhausted()) return throttle_clock::duration::zero();
+        return std::chrono::duration_cast<throttle_clock::duration>(std::chrono::duration<double>(-tokens / rate));
+    }
+
+    nlohmann::json throttle_stats::serialize() const {
+        nlohmann::json j = {
+                {"bytes_in", bytes_in.load()},
+                {"lines_in", lines_in.load()},
+                {"throttle_events", throttle_events.load()},
+                {"lines_dropped", lines_dropped.load()},
+                {"throttled_ms", throttled_ms.load()}
+        };
+        return j;
+    }
+
+    void input_throttle::configure(const throttle_config &cfg) {
+        auto now = throttle_clock::now();
+        lines.configure(cfg.line_rate, cfg.line_burst, now);
+        bytes.configure(cfg.byte_rate, cfg.byte_burst, now);
+    }
+
+    void input_throttle::countBytes(std::size_t amount) {
+        stats.bytes_in += amount;
+        bytes.consume(amount);
+    }
+
+    void input_throttle::countLine() {
+        stats.lines_in++;
+        lines.consume(1.0);
+    }
+
+    throttle_clock::duration input_throttle::delay() {
+        auto now = throttle_clock::now();
+        lines.refill(now);
+        bytes.refill(now);
+        return std::max(lines.waitTime(), bytes.waitTime());
+    }
+
+    bool input_throttle::enterThrottle() {
+        if(throttled) return false;
+        throttled = true;
+        throttled_since = throttle_clock::now();
+        stats.throttle_events++;
+        return true;
+    }
+
+    void input_throttle::leaveThrottle() {
+        if(!throttled) return;
+        throttled = false;
+        auto spent = std::chrono::duration_cast<std::chrono::milliseconds>(throttle_clock::now() - throttled_since);
+        stats.throttled_ms += spent.count();
+    }
+
+}
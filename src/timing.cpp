@@ -0,0 +1,133 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/timing.h"
+#include <cassert>
+
+namespace ring::net {
+
+    bool wheel_timer::armed() const {
+        return wheel != nullptr;
+    }
+
+    timing_wheel::timing_wheel(boost::asio::io_context &con, std::chrono::milliseconds res) : resolution(res),
+    origin(wheel_clock::now()), ticker(con) {}
+
+    void timing_wheel::start() {
+        std::lock_guard<std::mutex> guard(wheel_mutex);
+        if(running) return;
+        running = true;
+        schedule();
+    }
+
+    void timing_wheel::stop() {
+        std::lock_guard<std::mutex> guard(wheel_mutex);
+        running = false;
+        ticker.cancel();
+    }
+
+    void timing_wheel::schedule() {
+        ticker.expires_at(origin + resolution * (current + 1));
+        ticker.async_wait([this](auto ec) { if(!ec) tick(); });
+    }
+
+    std::size_t timing_wheel::size() const {
+        std::lock_guard<std::mutex> guard(wheel_mutex);
+        return count;
+    }
+
+    void timing_wheel::arm(wheel_timer &t, wheel_clock::duration after) {
+        std::lock_guard<std::mutex> guard(wheel_mutex);
+        // an entry belongs to one wheel. another wheel's lists can't be touched under this one's lock.
+        assert(!t.wheel || t.wheel == this);
+        // re-arming moves it rather than adding another.
+        if(t.wheel) {
+            unlink(t);
+            count--;
+        }
+        // round up, and never land in the slot we're currently sitting on.
+        uint64_t ticks = (after + resolution - wheel_clock::duration(1)) / resolution;
+        t.expires = current + std::max<uint64_t>(ticks, 1);
+        place(t);
+        count++;
+    }
+
+    void timing_wheel::cancel(wheel_timer &t) {
+        std::lock_guard<std::mutex> guard(wheel_mutex);
+        if(t.wheel != this) return;
+        unlink(t);
+        count--;
+    }
+
+    void timing_wheel::place(wheel_timer &t) {
+        uint64_t delta = t.expires > current ? t.expires - current : 0;
+        int level = 0;
+        while(level < levels - 1 && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) level++;
+        if(delta >= (uint64_t(1) << (slot_bits * levels))) {
+            // out of range, park it at the far edge.
+            t.expires = current + (uint64_t(1) << (slot_bits * levels)) - 1;
+        }
+        auto &head = slots[level][(t.expires >> (slot_bits * level)) & slot_mask];
+        t.wheel = this;
+        t.slot = &head;
+        t.prev = nullptr;
+        t.next = head;
+        if(head) head->prev = &t;
+        head = &t;
+    }
+
+    void timing_wheel::unlink(wheel_timer &t) {
+        if(t.prev) t.prev->next = t.next; else *t.slot = t.next;
+        if(t.next) t.next->prev = t.prev;
+        t.prev = t.next = nullptr;
+        t.slot = nullptr;
+        t.wheel = nullptr;
+    }
+
+    void timing_wheel::cascade(int level) {
+        auto &head = slots[level][(current >> (slot_bits * level)) & slot_mask];
+        auto t = head;
+        head = nullptr;
+        while(t) {
+            auto next = t->next;
+            place(*t);
+            t = next;
+        }
+    }
+
+    void timing_wheel::advance(std::vector<wheel_timer*> &expired) {
+        current++;
+        for(int level = 1; level < levels; level++) {
+            if(current & ((uint64_t(1) << (slot_bits * level)) - 1)) break;
+            cascade(level);
+        }
+        auto &head = slots[0][current & slot_mask];
+        auto t = head;
+        head = nullptr;
+        while(t) {
+            auto next = t->next;
+            t->prev = t->next = nullptr;
+            t->slot = nullptr;
+            t->wheel = nullptr;
+            count--;
+            expired.push_back(t);
+            t = next;
+        }
+    }
+
+    void timing_wheel::tick() {
+        std::vector<std::function<void()>> fire;
+        {
+            std::lock_guard<std::mutex> guard(wheel_mutex);
+            if(!running) return;
+            uint64_t target = (wheel_clock::now() - origin) / resolution;
+            std::vector<wheel_timer*> expired;
+            while(current < target) advance(expired);
+            for(auto t : expired) fire.push_back(t->callback);
+            schedule();
+        }
+        for(auto &f : fire) if(f) f();
+    }
+
+}
@@ -0,0 +1,439 @@
+//
+// Created by volund on 10/19/26.
+//
+
+#include "ringnet/uring.h"
+#include "ringnet/lag.h"
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <cstring>
+#define RINGNET_HAS_URING 1
+#endif
+
+namespace ring::net {
+
+#ifdef RINGNET_HAS_URING
+
+    namespace {
+        // how many times a full submission queue is pushed to the kernel before giving up on an sqe.
+        constexpr int max_submit_tries = 16;
+
+        int uringSetup(unsigned entries, io_uring_params *p) {
+            return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+        }
+
+        int uringEnter(int fd, unsigned submit, unsigned complete, unsigned flags) {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, submit, complete, flags, nullptr, 0));
+        }
+
+        int uringRegister(int fd, unsigned op, void *arg, unsigned count) {
+            return static_cast<int>(syscall(__NR_io_uring_register, fd, op, arg, count));
+        }
+
+        uint64_t userData(uint64_t id, UringOp op) {
+            return (id << 2) | op;
+        }
+
+        std::size_t pageRound(std::size_t size) {
+            auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            return (size + page - 1) / page * page;
+        }
+    }
+
+    bool uring_backend::supported() {
+        static const bool result = [] {
+            // multishot recv showed up in 6.0, everything else we use is older than that.
+            utsname u{};
+            if(uname(&u)) return false;
+            int major = 0, minor = 0;
+            if(sscanf(u.release, "%d.%d", &major, &minor) != 2) return false;
+            if(major < 6) return false;
+
+            io_uring_params p{};
+            int fd = uringSetup(8, &p);
+            if(fd < 0) return false;
+
+            auto size = pageRound(sizeof(io_uring_buf));
+            auto mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            bool ok = mem != MAP_FAILED;
+            if(ok) {
+                io_uring_buf_reg reg{};
+                reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+                reg.ring_entries = 1;
+                reg.bgid = 0;
+                ok = uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+                munmap(mem, size);
+            }
+            close(fd);
+            return ok;
+        }();
+        return result;
+    }
+
+    uring_backend::uring_backend(boost::asio::io_context &con, unsigned ent, unsigned buffers, unsigned buf_size)
+    : executor(con), notify(con), buffer_count(buffers), buffer_size(buf_size) {
+        // the provided buffer ring needs a power of two.
+        if(buffer_count & (buffer_count - 1)) {
+            std::cerr << "io_uring buffer count must be a power of two: " << buffer_count << std::endl;
+            return;
+        }
+
+        io_uring_params p{};
+        ring_fd = uringSetup(ent, &p);
+        if(ring_fd < 0) {
+            std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        entries = p.sq_entries;
+
+        sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+        sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if(sq_map == MAP_FAILED) {
+            sq_map = nullptr;
+            std::cerr << "io_uring sq mmap failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        cq_map = single ? sq_map : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if(cq_map == MAP_FAILED) {
+            cq_map = nullptr;
+            std::cerr << "io_uring cq mmap failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        sqe_map_size = p.sq_entries * sizeof(io_uring_sqe);
+        sqe_map = mmap(nullptr, sqe_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if(sqe_map == MAP_FAILED) {
+            sqe_map = nullptr;
+            std::cerr << "io_uring sqe mmap failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        auto sq = static_cast<uint8_t*>(sq_map);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sq_tail_local = *sq_tail;
+        sqes = sqe_map;
+
+        auto cq = static_cast<uint8_t*>(cq_map);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = cq + p.cq_off.cqes;
+
+        event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if(event_fd < 0 || uringRegister(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1)) {
+            std::cerr << "io_uring eventfd registration failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        buf_ring_size = pageRound(buffer_count * sizeof(io_uring_buf));
+        buf_ring_map = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(buf_ring_map == MAP_FAILED) {
+            buf_ring_map = nullptr;
+            std::cerr << "io_uring buffer ring mmap failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_map);
+        reg.ring_entries = buffer_count;
+        reg.bgid = 0;
+        if(uringRegister(ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1)) {
+            std::cerr << "io_uring buffer ring registration failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        buffer_memory.resize(static_cast<std::size_t>(buffer_count) * buffer_size);
+        for(unsigned i = 0; i < buffer_count; i++) recycle(i);
+
+        notify.assign(event_fd);
+        is_ready = true;
+    }
+
+    uring_backend::~uring_backend() {
+        boost::system::error_code ec;
+        if(notify.is_open()) {
+            notify.cancel(ec);
+            notify.release();
+        }
+        if(sqe_map) munmap(sqe_map, sqe_map_size);
+        if(cq_map && cq_map != sq_map) munmap(cq_map, cq_map_size);
+        if(sq_map) munmap(sq_map, sq_map_size);
+        if(ring_fd >= 0) close(ring_fd);
+        if(buf_ring_map) munmap(buf_ring_map, buf_ring_size);
+        if(event_fd >= 0) close(event_fd);
+    }
+
+    bool uring_backend::ready() const {
+        return is_ready;
+    }
+
+    void uring_backend::start() {
+        if(is_ready) wait();
+    }
+
+    void uring_backend::attach(uring_target &t) {
+        std::lock_guard<std::recursive_mutex> guard(target_mutex);
+        if(t.uring_id) return;
+        t.uring_id = next_id++;
+        targets.emplace(t.uring_id, &t);
+    }
+
+    void uring_backend::detach(uring_target &t) {
+        std::lock_guard<std::recursive_mutex> guard(target_mutex);
+        if(!t.uring_id) return;
+        targets.erase(t.uring_id);
+        // a send still in flight keeps its bytes until the completion comes back for them.
+        auto op = sends.find(t.uring_id);
+        if(op != sends.end() && !op->second.in_flight) sends.erase(op);
+        t.uring_id = 0;
+        t.recv_armed = t.accept_armed = false;
+    }
+
+    uring_target *uring_backend::find(uint64_t id) {
+        auto found = targets.find(id);
+        return found == targets.end() ? nullptr : found->second;
+    }
+
+    void *uring_backend::nextSqe() {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        for(int tries = 0; sq_tail_local - head >= entries; tries++) {
+            // the submission queue is full, push what we have to the kernel and try again. if it won't take
+            // any, spinning here with sq_mutex held would stall every other thread that wants to submit.
+            if(tries == max_submit_tries) return nullptr;
+            auto done = uringEnter(ring_fd, pending, 0, 0);
+            if(done > 0) pending -= done;
+            head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        }
+        auto index = sq_tail_local & *sq_mask;
+        auto sqe = &static_cast<io_uring_sqe*>(sqes)[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        sq_array[index] = index;
+        return sqe;
+    }
+
+    void uring_backend::pushSqe() {
+        sq_tail_local++;
+        __atomic_store_n(sq_tail, sq_tail_local, __ATOMIC_RELEASE);
+        pending++;
+        if(!submit_posted) {
+            // everything queued before this runs goes to the kernel in one io_uring_enter.
+            submit_posted = true;
+            boost::asio::post(executor, timed("uring submit", [this] { submit(); }));
+        }
+    }
+
+    void uring_backend::submit() {
+        std::lock_guard<std::mutex> guard(sq_mutex);
+        submit_posted = false;
+        if(!pending) return;
+        auto done = uringEnter(ring_fd, pending, 0, 0);
+        if(done > 0) {
+            pending -= done;
+        } else if(done < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR) {
+            std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+        }
+        if(pending && !submit_posted) {
+            submit_posted = true;
+            boost::asio::post(executor, timed("uring submit", [this] { submit(); }));
+        }
+    }
+
+    bool uring_backend::recv(uring_target &t, int fd) {
+        if(!t.uring_id || t.recv_armed.exchange(true)) return true;
+        std::lock_guard<std::mutex> guard(sq_mutex);
+        auto sqe = static_cast<io_uring_sqe*>(nextSqe());
+        if(!sqe) {
+            t.recv_armed = false;
+            return false;
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->user_data = userData(t.uring_id, UringRecv);
+        pushSqe();
+        return true;
+    }
+
+    bool uring_backend::send(uring_target &t, int fd, const void *data, std::size_t len,
+                             std::shared_ptr<const std::vector<uint8_t>> shared) {
+        std::lock_guard<std::recursive_mutex> targets_guard(target_mutex);
+        if(!t.uring_id) return true;
+        // submission waits for the next pass and the kernel reads the bytes whenever it gets to them, by
+        // which time the target may have moved or freed its own.
+        auto &op = sends[t.uring_id];
+        op.in_flight = true;
+        if(shared) {
+            op.shared = std::move(shared);
+        } else {
+            auto bytes = static_cast<const uint8_t*>(data);
+            op.bytes.assign(bytes, bytes + len);
+            data = op.bytes.data();
+        }
+        std::lock_guard<std::mutex> guard(sq_mutex);
+        auto sqe = static_cast<io_uring_sqe*>(nextSqe());
+        if(!sqe) {
+            op.in_flight = false;
+            op.shared.reset();
+            return false;
+        }
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(data);
+        sqe->len = static_cast<uint32_t>(std::min<std::size_t>(len, UINT32_MAX));
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = userData(t.uring_id, UringSend);
+        pushSqe();
+        return true;
+    }
+
+    bool uring_backend::accept(uring_target &t, int fd) {
+        if(!t.uring_id || t.accept_armed.exchange(true)) return true;
+        std::lock_guard<std::mutex> guard(sq_mutex);
+        auto sqe = static_cast<io_uring_sqe*>(nextSqe());
+        if(!sqe) {
+            t.accept_armed = false;
+            return false;
+        }
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        // no CLOEXEC: accepted sockets have to survive a copyover exec.
+        sqe->accept_flags = 0;
+        sqe->user_data = userData(t.uring_id, UringAccept);
+        pushSqe();
+        return true;
+    }
+
+    void uring_backend::cancel(uring_target &t, UringOp op) {
+        if(!t.uring_id) return;
+        std::lock_guard<std::mutex> guard(sq_mutex);
+        auto sqe = static_cast<io_uring_sqe*>(nextSqe());
+        // the op runs on, and its completions still arrive and are dealt with. nothing is lost but the cancel.
+        if(!sqe) return;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = userData(t.uring_id, op);
+        sqe->user_data = userData(t.uring_id, UringCancel);
+        pushSqe();
+    }
+
+    void uring_backend::recycle(uint16_t bid) {
+        // not ring->bufs: under C++ the header's flex array macro shifts it off the start of the ring.
+        auto ring = static_cast<io_uring_buf_ring*>(buf_ring_map);
+        auto &buf = static_cast<io_uring_buf*>(buf_ring_map)[buf_tail & (buffer_count - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(buffer_memory.data() + static_cast<std::size_t>(bid) * buffer_size);
+        buf.len = buffer_size;
+        buf.bid = bid;
+        buf_tail++;
+        __atomic_store_n(&ring->tail, buf_tail, __ATOMIC_RELEASE);
+    }
+
+    void uring_backend::wait() {
+        notify.async_wait(boost::asio::posix::stream_descriptor::wait_read, recycled([this](auto ec) {
+            if(ec) return;
+            uint64_t count;
+            while(::read(event_fd, &count, sizeof(count)) > 0);
+            drain();
+            wait();
+        }));
+    }
+
+    void uring_backend::drain() {
+        unsigned head = *cq_head;
+        while(true) {
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            if(head == tail) break;
+            auto cqe = &static_cast<io_uring_cqe*>(cqes)[head & *cq_mask];
+            auto data = cqe->user_data;
+            auto res = cqe->res;
+            auto flags = cqe->flags;
+            head++;
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+            auto op = static_cast<UringOp>(data & 3);
+            auto id = data >> 2;
+            bool more = flags & IORING_CQE_F_MORE;
+
+            std::lock_guard<std::recursive_mutex> guard(target_mutex);
+            auto t = find(id);
+            switch(op) {
+                case UringRecv: {
+                    const uint8_t *buf = nullptr;
+                    int bid = -1;
+                    if(flags & IORING_CQE_F_BUFFER) {
+                        bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                        buf = buffer_memory.data() + static_cast<std::size_t>(bid) * buffer_size;
+                    }
+                    if(t) {
+                        if(!more) t->recv_armed = false;
+                        t->onUringRecv(res, buf, res > 0 ? res : 0, more);
+                    }
+                    // whatever the target wanted out of it has been copied by now.
+                    if(bid >= 0) recycle(bid);
+                    break;
+                }
+                case UringSend: {
+                    auto sent = sends.find(id);
+                    if(!t) {
+                        if(sent != sends.end()) sends.erase(sent);
+                        break;
+                    }
+                    if(sent != sends.end()) {
+                        sent->second.in_flight = false;
+                        sent->second.shared.reset();
+                    }
+                    t->onUringSend(res);
+                    break;
+                }
+                case UringAccept:
+                    if(t) {
+                        if(!more) t->accept_armed = false;
+                        t->onUringAccept(res, more);
+                    } else if(res >= 0) {
+                        close(res);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        submit();
+    }
+
+#else
+
+    bool uring_backend::supported() {
+        return false;
+    }
+
+    uring_backend::uring_backend(boost::asio::io_context &con, unsigned, unsigned, unsigned)
+    : executor(con), notify(con) {}
+
+    uring_backend::~uring_backend() {}
+
+    bool uring_backend::ready() const { return false; }
+    void uring_backend::start() {}
+    void uring_backend::attach(uring_target &) {}
+    void uring_backend::detach(uring_target &) {}
+    bool uring_backend::recv(uring_target &, int) { return false; }
+    bool uring_backend::send(uring_target &, int, const void *, std::size_t, std::shared_ptr<const std::vector<uint8_t>>) { return false; }
+    bool uring_backend::accept(uring_target &, int) { return false; }
+    void uring_backend::cancel(uring_target &, UringOp) {}
+    void uring_backend::submit() {}
+
+#endif
+
+}